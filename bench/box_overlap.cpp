@@ -0,0 +1,199 @@
+// cross-checks intersectss(Box, Box), the per-axis overlap test (SSE on x86-64), over random pairs of boxes:
+// against a plain per-axis reference, which it must match exactly,
+// and against the old test by vertices, for the record: it misses the overlaps of crossed boxes and of boxes with coincident faces,
+// and rounds the margin differently next to a touching face
+// pairs come in kinds: random, touching (faces a margin apart), nested, crossed and degenerate (flat, points, inverted),
+// each in both argument orders and with the margins the octree uses
+// usage: box_overlap [pairs per kind] [seed]
+// exits with 1 if the test and the reference disagree on any pair
+// needs only shapes.h, e.g.
+// g++ -std=c++17 -O2 -I../src -I<glm> box_overlap.cpp
+
+#include "shapes.h"
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// the overlap of the intervals on every axis, grown by the margin, one comparison at a time
+bool reference(const Box& box1, const Box& box2, const float MARGIN) {
+    for (int i = 0; i < 3; i++) {
+        if (!(box1.mins[i] < box2.maxs[i] + MARGIN))
+            return false;
+        if (!(box2.mins[i] - MARGIN < box1.maxs[i]))
+            return false;
+    }
+    return true;
+}
+
+// the test before the per-axis one: a coordinate of a vertex of one box within the other on every axis
+bool byVertices(const Box& box1, const Box& box2, const float MARGIN) {
+    auto isVertexContained = [&](const Box& box1, const Box& box2) {
+        for (int i = 0; i < 3; i++) {
+            if (box2.mins[i] - MARGIN < box1.mins[i] && box1.mins[i] < box2.maxs[i] + MARGIN)
+                continue;
+            if (box2.mins[i] - MARGIN < box1.maxs[i] && box1.maxs[i] < box2.maxs[i] + MARGIN)
+                continue;
+            return false;
+        }
+        return true;
+    };
+    return isVertexContained(box1, box2) || isVertexContained(box2, box1);
+}
+
+using Pair = std::pair<Box, Box>;
+
+struct Kind {
+    std::string name;
+    std::function<Pair(std::mt19937&, float margin)> make;
+};
+
+Box randomBox(std::mt19937& rng, float maxSize) {
+    std::uniform_real_distribution<float> cDist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> sDist(0.0f, maxSize);
+    Box box;
+    for (int i = 0; i < 3; i++) {
+        box.mins[i] = cDist(rng);
+        box.maxs[i] = box.mins[i] + sDist(rng);
+    }
+    return box;
+}
+
+std::vector<Kind> kinds() {
+    std::uniform_int_distribution<int> axisDist(0, 2);
+    std::uniform_real_distribution<float> uDist(0.0f, 1.0f);
+    return {
+        { "random", [=](std::mt19937& rng, float) mutable {
+            return Pair{ randomBox(rng, 8.0f), randomBox(rng, 8.0f) };
+        } },
+        // on one axis, the second box starts exactly where the first ends, grown by the margin, or a float step either way
+        { "touching", [=](std::mt19937& rng, float margin) mutable {
+            Box box1 = randomBox(rng, 4.0f);
+            Box box2 = box1;
+            const int axis = axisDist(rng);
+            const float size = box2.maxs[axis] - box2.mins[axis];
+            float start = box1.maxs[axis] + margin;
+            const int step = axisDist(rng) - 1;
+            if (step != 0)
+                start = std::nextafter(start, step * std::numeric_limits<float>::infinity());
+            box2.mins[axis] = start;
+            box2.maxs[axis] = start + size;
+            return Pair{ box1, box2 };
+        } },
+        { "nested", [=](std::mt19937& rng, float) mutable {
+            Box box1 = randomBox(rng, 8.0f);
+            Box box2;
+            for (int i = 0; i < 3; i++) {
+                float a = box1.mins[i] + (box1.maxs[i] - box1.mins[i]) * uDist(rng);
+                float b = box1.mins[i] + (box1.maxs[i] - box1.mins[i]) * uDist(rng);
+                box2.mins[i] = std::min(a, b);
+                box2.maxs[i] = std::max(a, b);
+            }
+            return Pair{ box1, box2 };
+        } },
+        // each box spans the other along a different axis, so neither has a vertex within the other
+        { "crossed", [=](std::mt19937& rng, float) mutable {
+            Box box1, box2;
+            const int long1 = axisDist(rng);
+            const int long2 = (long1 + 1 + axisDist(rng) % 2) % 3;
+            for (int i = 0; i < 3; i++) {
+                const float c = 10.0f * (2 * uDist(rng) - 1);
+                const float h1 = i == long1 ? 4.0f : 1.0f;
+                const float h2 = i == long2 ? 4.0f : 1.0f;
+                box1.mins[i] = c - h1 * (0.5f + uDist(rng));
+                box1.maxs[i] = c + h1 * (0.5f + uDist(rng));
+                box2.mins[i] = c - h2 * (0.5f + uDist(rng));
+                box2.maxs[i] = c + h2 * (0.5f + uDist(rng));
+            }
+            return Pair{ box1, box2 };
+        } },
+        // flat on some axes or points, sharing coordinates with the other box, or inverted as the content of an empty node
+        { "degenerate", [=](std::mt19937& rng, float) mutable {
+            Box box1 = randomBox(rng, 4.0f);
+            Box box2 = randomBox(rng, 4.0f);
+            for (int i = 0; i < 3; i++) {
+                switch (axisDist(rng)) {
+                case 0:
+                    box2.mins[i] = box2.maxs[i] = uDist(rng) < 0.5f ? box1.mins[i] : box1.maxs[i];
+                    break;
+                case 1:
+                    box2.mins[i] = box2.maxs[i] = box1.mins[i] + (box1.maxs[i] - box1.mins[i]) * uDist(rng);
+                    break;
+                default:
+                    box1.maxs[i] = box1.mins[i];
+                    break;
+                }
+            }
+            if (uDist(rng) < 0.1f) {
+                constexpr float MAX = std::numeric_limits<float>::max();
+                box2 = Box(MAX, MAX, MAX, -MAX, -MAX, -MAX);
+            }
+            return Pair{ box1, box2 };
+        } },
+    };
+}
+
+int main(int argc, char** argv) {
+    int pairs = 1'000'000;
+    unsigned int seed = 1;
+    if (argc > 1)
+        pairs = std::atoi(argv[1]);
+    if (argc > 2)
+        seed = std::atoi(argv[2]);
+
+#ifdef SHAPES_SSE
+    std::cout << "intersectss(Box, Box) with SSE";
+#else
+    std::cout << "intersectss(Box, Box) without SSE";
+#endif
+    std::cout << ", " << pairs << " pairs per kind and margin, both orders" << std::endl;
+    std::cout
+        << std::setw(12) << "kind"
+        << std::setw(10) << "margin"
+        << std::setw(12) << "overlaps"
+        << std::setw(12) << "mismatches"
+        << std::setw(14) << "old missed"
+        << std::setw(14) << "old extra"
+        << std::endl;
+
+    bool isAgreeing = true;
+    std::mt19937 rng(seed);
+    // of an intersection test, of the node pruning, and of a leaf test that underestimates the objects
+    for (const Kind& kind : kinds()) {
+        for (float margin : { 0.0f, 0.01f, -0.000'01f }) {
+            long long overlaps = 0, mismatches = 0, oldMissed = 0, oldExtra = 0;
+            for (int n = 0; n < pairs; n++) {
+                Pair pair = kind.make(rng, margin);
+                for (int order = 0; order < 2; order++) {
+                    const Box& box1 = order == 0 ? pair.first : pair.second;
+                    const Box& box2 = order == 0 ? pair.second : pair.first;
+                    const bool expected = reference(box1, box2, margin);
+                    const bool old = byVertices(box1, box2, margin);
+                    overlaps += expected;
+                    mismatches += intersectss(box1, box2, margin) != expected;
+                    oldMissed += expected && !old;
+                    oldExtra += !expected && old;
+                }
+            }
+            isAgreeing = isAgreeing && mismatches == 0;
+            std::cout
+                << std::setw(12) << kind.name
+                << std::setw(10) << margin
+                << std::setw(12) << overlaps
+                << std::setw(12) << mismatches
+                << std::setw(14) << oldMissed
+                << std::setw(14) << oldExtra
+                << std::endl;
+        }
+    }
+    std::cout << (isAgreeing ? "ok" : "MISMATCH") << std::endl;
+    return isAgreeing ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// the simulation of the demo without a window or a GL context, e.g. on a headless build machine
+// usage: headless [N] [capacity] [seed] [steps] [dt] [trace] [restructure us]
+// with a trace path (not -), the moves are recorded for bench/replay.cpp
+// with a restructure budget, the splits and merges of a step are deferred and done within that many microseconds at its end
+// needs only the octree library and the simulation, e.g.
+// g++ -std=c++17 -O2 -I../src -I<glm> headless.cpp ../src/simulation.cpp ../src/moving_body.cpp ../src/trace.cpp ../src/profiler.cpp ../src/octree.cpp ../src/geometry.cpp ../src/body.cpp ../src/narrow_phase.cpp
+
+#include "simulation.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <algorithm>
+
+constexpr float MAX_COORDINATE = 10.0f;
+constexpr float FAT_MARGIN = 0.1f;
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int N = 10000;
+    int capacity = OctreeNode::CAPACITY;
+    unsigned int seed = 1;
+    int steps = 100;
+    double dt = 1.0 / 60;
+    std::string tracePath;
+    int restructureBudget = 0;
+    try {
+        if (argc > 1)
+            N = std::stoi(argv[1]);
+        if (argc > 2)
+            capacity = std::stoi(argv[2]);
+        if (argc > 3)
+            seed = std::stoul(argv[3]);
+        if (argc > 4)
+            steps = std::stoi(argv[4]);
+        if (argc > 5)
+            dt = std::stod(argv[5]);
+        if (argc > 6 && std::string(argv[6]) != "-")
+            tracePath = argv[6];
+        if (argc > 7)
+            restructureBudget = std::stoi(argv[7]);
+    }
+    catch (const std::exception&) {
+        std::cerr << "usage: " << argv[0] << " [N] [capacity] [seed] [steps] [dt] [trace] [restructure us]" << std::endl;
+        return -1;
+    }
+    if (N < 1 || capacity < 1 || steps < 0 || dt <= 0 || restructureBudget < 0) {
+        std::cerr << "N, capacity and dt have to be positive, and the restructure budget not negative" << std::endl;
+        return -1;
+    }
+
+    Simulation simulation(MAX_COORDINATE, FAT_MARGIN, capacity);
+    simulation.rng = std::mt19937(seed);
+    // every object moves randomly, nothing is selected
+    MotionInput input;
+    input.randomMoves = true;
+
+    if (isProfiling)
+        timeline.start();
+    auto start = std::chrono::steady_clock::now();
+    simulation.makeObjects(N);
+    // after the objects, so that they are not all queued in the root
+    simulation.setRestructureBudget(std::chrono::microseconds(restructureBudget));
+    // long runs drift away from the octree they started with
+    OctreeRebuildPolicy policy;
+    policy.isEnabled = true;
+    simulation.octree.setRebuildPolicy(policy);
+    if (!tracePath.empty() && !simulation.startTrace(tracePath))
+        return -1;
+    std::cout << "N = " << N << ", node capacity = " << capacity << ", seed = " << seed
+        << ", steps = " << steps << ", dt = " << dt << ", restructure us = " << restructureBudget << std::endl;
+    std::cout << "insert ms = " << std::fixed << std::setprecision(2) << millisecondsSince(start) << std::endl;
+
+    std::cout
+        << std::setw(8) << "step"
+        << std::setw(12) << "ms"
+        << std::setw(10) << "awake"
+        << std::setw(12) << "leaves/obj"
+        << std::setw(12) << "node KiB"
+        << std::setw(8) << "depth"
+        << std::setw(10) << "splits"
+        << std::setw(10) << "merges"
+        << std::setw(10) << "rebuilt"
+        << std::setw(10) << "pending"
+        << std::endl;
+    simulation.octree.resetCounters();
+    double total = 0, worst = 0;
+    for (int step = 1; step <= steps; step++) {
+        start = std::chrono::steady_clock::now();
+        simulation.update(input, step * dt);
+        // due by the statistics of the last step
+        const bool isRebuilt = simulation.maintain();
+        const double time = millisecondsSince(start);
+        total += time;
+        worst = std::max(worst, time);
+
+        simulation.octree.publishStats();
+        const OctreeStats stats = simulation.octree.stats();
+        std::cout
+            << std::setw(8) << step
+            << std::setw(12) << time
+            << std::setw(10) << simulation.numAwakeObjects()
+            << std::setw(12) << stats.duplication()
+            << std::setw(12) << stats.bytes / 1024
+            << std::setw(8) << (int)stats.leavesByDepth.size() - 1
+            << std::setw(10) << stats.counters.splits
+            << std::setw(10) << stats.counters.merges
+            << std::setw(10) << isRebuilt
+            << std::setw(10) << stats.pendingRestructures
+            << std::endl;
+    }
+    if (steps > 0)
+        std::cout << "mean ms = " << total / steps << ", max ms = " << worst << std::endl;
+    if (isProfiling && profiler.writeJson("profile.json") && timeline.writeJson("timeline.json"))
+        std::cout << "profile saved to profile.json and timeline.json" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,373 @@
+// the octree operations one at a time, over object counts, node capacities, size distributions and shape mixes
+// prints a row per (configuration, operation) with the time, the nodes visited and the narrow-phase tests per operation
+// usage: octree_bench [csv|json] [max N] [seed] [fat margin]
+// object counts go 1k, 10k, ... up to max N (100k by default, 1M takes a while)
+// needs only the octree library, e.g.
+// g++ -std=c++17 -O2 -I../src -I<glm> octree_bench.cpp ../src/profiler.cpp ../src/octree.cpp ../src/geometry.cpp ../src/body.cpp ../src/narrow_phase.cpp
+
+#include "octree.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// in objects per operation type, fewer if there are fewer objects
+constexpr int QUERIES = 20'000;
+// of the volume of the octree, on average
+constexpr float VOLUME_FRACTION = 0.1f;
+constexpr float CAPSULE_ELONGATION = 3.0f;
+// as in Simulation::makeObjects
+constexpr float MIN_SCALE = 0.001f;
+constexpr float MAX_SCALE = 1.0f;
+
+enum class Sizes { UNIFORM, CLUSTERED, MIXED };
+enum class Shapes { SPHERES, CUBES, MIXED };
+
+const char* name(Sizes sizes) {
+    switch (sizes) {
+    case Sizes::UNIFORM: return "uniform";
+    case Sizes::CLUSTERED: return "clustered";
+    default: return "mixed";
+    }
+}
+
+const char* name(Shapes shapes) {
+    switch (shapes) {
+    case Shapes::SPHERES: return "spheres";
+    case Shapes::CUBES: return "cubes";
+    default: return "mixed";
+    }
+}
+
+struct Config {
+    int N;
+    int capacity;
+    Sizes sizes;
+    Shapes shapes;
+};
+
+struct Row {
+    Config config;
+    int objects; // inserted, clustered scenes may not fit all N
+    float maxCoordinate;
+    double registrationsPerObject;
+    size_t nodeBytes;
+    double bytesPerNode;
+    std::string op;
+    long long ops;
+    double nsPerOp;
+    double nodesPerOp;
+    double narrowTestsPerOp;
+    long long hits; // meaning depends on op, e.g. failed updates
+};
+
+// what a generated object is made of, before it becomes a body
+struct Spec {
+    SolidBodyType type;
+    float scale;
+    glm::vec3 axis;
+    float degrees;
+};
+
+class Scene {
+public:
+    Scene(const Config& config, std::mt19937& rng) : config(config), rng(rng) {
+        // the octree grows with N so that the objects fill about the same fraction of it
+        double volume = 0;
+        for (int i = 0; i < 1000; i++)
+            volume += volumeOf(makeSpec());
+        maxCoordinate = 0.5f * std::cbrt(float(config.N * volume / 1000 / VOLUME_FRACTION));
+        std::uniform_real_distribution<float> tDist(-maxCoordinate, maxCoordinate);
+        for (auto& center : clusterCenters)
+            center = { tDist(rng) * 0.7f, tDist(rng) * 0.7f, tDist(rng) * 0.7f };
+    }
+
+    Spec makeSpec() {
+        std::uniform_real_distribution<float> aDist(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> degreeDist(0.0f, 360.0f);
+        int type = 0;
+        if (config.shapes == Shapes::CUBES)
+            type = 1;
+        else if (config.shapes == Shapes::MIXED)
+            type = std::uniform_int_distribution<int>(0, 3)(rng);
+
+        float scale;
+        if (config.sizes == Sizes::MIXED)
+            scale = std::uniform_real_distribution<float>(MIN_SCALE, MAX_SCALE)(rng);
+        else
+            scale = std::uniform_real_distribution<float>(0.05f, 0.25f)(rng);
+        // about the same volume for every shape, as in Simulation::makeObjects
+        if (type == 1 || type == 2)
+            scale /= 1.25f;
+        else if (type == 3)
+            scale /= 1.75f;
+
+        const SolidBodyType types[] = { SolidBodyType::SPHERE, SolidBodyType::CUBE, SolidBodyType::ORIENTED_CUBE, SolidBodyType::CAPSULE };
+        return { types[type], scale, { aDist(rng), aDist(rng), aDist(rng) + 0.001f }, degreeDist(rng) };
+    }
+
+    static double volumeOf(const Spec& spec) {
+        const double s = spec.scale;
+        switch (spec.type) {
+        case SolidBodyType::SPHERE: return 4.0 / 3 * glm::pi<double>() * s * s * s;
+        case SolidBodyType::CAPSULE: return glm::pi<double>() * s * s * s * (4.0 / 3 + 2 * CAPSULE_ELONGATION);
+        default: return 8 * s * s * s;
+        }
+    }
+
+    glm::vec3 makePosition() {
+        if (config.sizes != Sizes::CLUSTERED) {
+            std::uniform_real_distribution<float> tDist(-maxCoordinate, maxCoordinate);
+            return { tDist(rng), tDist(rng), tDist(rng) };
+        }
+        const glm::vec3 center = clusterCenters[std::uniform_int_distribution<int>(0, NUM_CLUSTERS - 1)(rng)];
+        std::normal_distribution<float> offset(0.0f, maxCoordinate / 8);
+        glm::vec3 position = center + glm::vec3(offset(rng), offset(rng), offset(rng));
+        return glm::clamp(position, glm::vec3(-maxCoordinate), glm::vec3(maxCoordinate));
+    }
+
+    // not in the octree yet
+    std::unique_ptr<Body> makeBody() {
+        const Spec spec = makeSpec();
+        auto body = std::make_unique<Body>(spec.type);
+        if (spec.type == SolidBodyType::CAPSULE)
+            geometry.elongation[body->getID()] = CAPSULE_ELONGATION;
+        body->scale(spec.scale);
+        if (spec.type == SolidBodyType::ORIENTED_CUBE || spec.type == SolidBodyType::CAPSULE)
+            body->rotate(spec.axis, spec.degrees);
+        body->translate(makePosition());
+        return body;
+    }
+
+    float maxCoordinate;
+private:
+    static constexpr int NUM_CLUSTERS = 8;
+    const Config config;
+    std::mt19937& rng;
+    std::array<glm::vec3, NUM_CLUSTERS> clusterCenters;
+};
+
+// runs the operations of batch, which sets the number of operations and hits of the row,
+// and fills in the time and the counters per operation
+template <typename Batch>
+Row measure(Octree& octree, const std::string& name, Batch batch) {
+    Row row{};
+    row.op = name;
+    octree.resetCounters();
+    auto start = std::chrono::steady_clock::now();
+    batch(row);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (row.ops > 0) {
+        row.nsPerOp = ns / row.ops;
+        row.nodesPerOp = double(octree.getCounters().nodesVisited) / row.ops;
+        row.narrowTestsPerOp = double(octree.getCounters().narrowTests) / row.ops;
+    }
+    return row;
+}
+
+std::vector<Row> run(const Config& config, unsigned int seed, float fatMargin) {
+    std::mt19937 rng(seed);
+    Scene scene(config, rng);
+    Octree octree(scene.maxCoordinate, fatMargin, config.capacity);
+    std::vector<Row> rows;
+    std::vector<std::unique_ptr<Body>> objects;
+    std::uniform_real_distribution<float> tDist(-scene.maxCoordinate, scene.maxCoordinate);
+
+    // failed attempts (an intersection or outside of the octree) count as operations as well, hits are the inserted ones
+    const long long maxAttempts = 20LL * config.N;
+    rows.push_back(measure(octree, "insert", [&](Row& row) {
+        for (; (int)objects.size() < config.N && row.ops < maxAttempts; row.ops++) {
+            auto body = scene.makeBody();
+            if (octree.insert(body.get()))
+                objects.push_back(std::move(body));
+        }
+        row.hits = objects.size();
+    }));
+
+    const int queries = std::min<int>(QUERIES, objects.size());
+    std::vector<std::unique_ptr<Body>> probes;
+    for (int i = 0; i < queries; i++)
+        probes.push_back(scene.makeBody());
+    rows.push_back(measure(octree, "intersects", [&](Row& row) {
+        for (; row.ops < queries; row.ops++)
+            row.hits += octree.intersects(probes[row.ops].get());
+    }));
+
+    std::vector<glm::vec3> from(queries), to(queries);
+    for (int i = 0; i < queries; i++) {
+        from[i] = { tDist(rng), tDist(rng), tDist(rng) };
+        to[i] = { tDist(rng), tDist(rng), tDist(rng) };
+    }
+    rows.push_back(measure(octree, "rayQuery", [&](Row& row) {
+        for (; row.ops < queries; row.ops++)
+            row.hits += octree.rayQuery(from[row.ops], to[row.ops]).object != nullptr;
+    }));
+    // the same rays in packets, per ray: random rays diverge at once, so packets don't pay off for them
+    rows.push_back(measure(octree, "rayQueryBatch", [&](Row& row) {
+        for (const RayHit& hit : octree.rayQueryBatch(from, to))
+            row.hits += hit.object != nullptr;
+        row.ops = queries;
+    }));
+    // a camera-style grid of rays from outside the octree, through a field of view of 60 degrees,
+    // in 2x2 tiles so that every packet holds neighbouring rays
+    const int side = std::max(2, (int)std::sqrt((float)queries) / 2 * 2);
+    std::vector<glm::vec3> gridFrom(side * side), gridTo(side * side);
+    const glm::vec3 eye{ 0.0f, 0.0f, -2 * scene.maxCoordinate };
+    const float spread = std::tan(glm::radians(30.0f));
+    for (int i = 0; i < side * side; i++) {
+        const int tile = i / 4, lane = i % 4;
+        const int x = tile % (side / 2) * 2 + lane % 2, y = tile / (side / 2) * 2 + lane / 2;
+        const glm::vec3 direction{ spread * (2.0f * (x + 0.5f) / side - 1), spread * (2.0f * (y + 0.5f) / side - 1), 1.0f };
+        gridFrom[i] = eye;
+        gridTo[i] = eye + glm::normalize(direction) * 4.0f * scene.maxCoordinate;
+    }
+    rows.push_back(measure(octree, "rayQuery_coherent", [&](Row& row) {
+        for (; row.ops < side * side; row.ops++)
+            row.hits += octree.rayQuery(gridFrom[row.ops], gridTo[row.ops]).object != nullptr;
+    }));
+    rows.push_back(measure(octree, "rayQueryBatch_coherent", [&](Row& row) {
+        for (const RayHit& hit : octree.rayQueryBatch(gridFrom, gridTo))
+            row.hits += hit.object != nullptr;
+        row.ops = side * side;
+    }));
+    // the same random rays, the first k objects along each or all of them, hits counts the objects
+    std::vector<RayInterval> intervals;
+    for (int k : { 1, 8, std::numeric_limits<int>::max() }) {
+        const std::string name = "rayQueryAll_" + (k == std::numeric_limits<int>::max() ? std::string("all") : std::to_string(k));
+        rows.push_back(measure(octree, name, [&](Row& row) {
+            for (; row.ops < queries; row.ops++) {
+                octree.rayQueryAll(from[row.ops], to[row.ops], intervals, k);
+                row.hits += intervals.size();
+            }
+        }));
+    }
+
+    // the objects moved, at the speeds of the demo
+    std::vector<Body*> moved(queries);
+    std::vector<glm::vec3> displacements(queries);
+    std::uniform_int_distribution<size_t> objectDist(0, objects.size() - 1);
+    std::uniform_real_distribution<float> dDist(-0.05f, 0.05f);
+    for (int i = 0; i < queries; i++) {
+        moved[i] = objects[objectDist(rng)].get();
+        displacements[i] = { dDist(rng), dDist(rng), dDist(rng) };
+    }
+    rows.push_back(measure(octree, "sweep", [&](Row& row) {
+        for (; row.ops < queries; row.ops++)
+            row.hits += octree.sweep(moved[row.ops], displacements[row.ops]).object != nullptr;
+    }));
+    // failed updates are reverted, hits counts them
+    rows.push_back(measure(octree, "update", [&](Row& row) {
+        for (; row.ops < queries; row.ops++) {
+            moved[row.ops]->translate(displacements[row.ops]);
+            row.hits += !octree.update(moved[row.ops]);
+        }
+    }));
+
+    const double registrationsPerObject = objects.empty() ? 0.0 : double(octree.registrations()) / objects.size();
+    const size_t nodeBytes = octree.nodeMemoryUsage();
+    // the counters are reset per operation anyway
+    octree.publishStats(false);
+    const double bytesPerNode = octree.stats().bytesPerNode();
+    rows.push_back(measure(octree, "remove", [&](Row& row) {
+        for (; row.ops < (long long)objects.size(); row.ops++)
+            octree.remove(objects[row.ops].get());
+    }));
+
+    for (auto& row : rows) {
+        row.config = config;
+        row.objects = objects.size();
+        row.maxCoordinate = scene.maxCoordinate;
+        row.registrationsPerObject = registrationsPerObject;
+        row.nodeBytes = nodeBytes;
+        row.bytesPerNode = bytesPerNode;
+    }
+    return rows;
+}
+
+void printCsvHeader() {
+    std::cout << "n,capacity,sizes,shapes,objects,max_coordinate,registrations_per_object,node_bytes,bytes_per_node,"
+        << "op,ops,ns_per_op,nodes_per_op,narrow_tests_per_op,hits" << std::endl;
+}
+
+void printCsv(const Row& row) {
+    std::cout << row.config.N << ',' << row.config.capacity << ',' << name(row.config.sizes) << ',' << name(row.config.shapes) << ','
+        << row.objects << ',' << row.maxCoordinate << ',' << row.registrationsPerObject << ',' << row.nodeBytes << ',' << row.bytesPerNode << ','
+        << row.op << ',' << row.ops << ',' << row.nsPerOp << ',' << row.nodesPerOp << ',' << row.narrowTestsPerOp << ','
+        << row.hits << std::endl;
+}
+
+void printJson(const Row& row, bool isFirst) {
+    std::cout << (isFirst ? "  " : ",\n  ")
+        << "{\"n\": " << row.config.N << ", \"capacity\": " << row.config.capacity
+        << ", \"sizes\": \"" << name(row.config.sizes) << "\", \"shapes\": \"" << name(row.config.shapes) << "\""
+        << ", \"objects\": " << row.objects << ", \"max_coordinate\": " << row.maxCoordinate
+        << ", \"registrations_per_object\": " << row.registrationsPerObject << ", \"node_bytes\": " << row.nodeBytes
+        << ", \"bytes_per_node\": " << row.bytesPerNode
+        << ", \"op\": \"" << row.op << "\", \"ops\": " << row.ops << ", \"ns_per_op\": " << row.nsPerOp
+        << ", \"nodes_per_op\": " << row.nodesPerOp << ", \"narrow_tests_per_op\": " << row.narrowTestsPerOp
+        << ", \"hits\": " << row.hits << "}";
+}
+
+int main(int argc, char** argv) {
+    bool isJson = false;
+    int maxN = 100'000;
+    unsigned int seed = 1;
+    float fatMargin = 0.0f;
+    try {
+        if (argc > 1) {
+            const std::string format = argv[1];
+            if (format != "csv" && format != "json")
+                throw std::invalid_argument(format);
+            isJson = format == "json";
+        }
+        if (argc > 2)
+            maxN = std::stoi(argv[2]);
+        if (argc > 3)
+            seed = std::stoul(argv[3]);
+        if (argc > 4)
+            fatMargin = std::stof(argv[4]);
+    }
+    catch (const std::exception&) {
+        std::cerr << "usage: " << argv[0] << " [csv|json] [max N] [seed] [fat margin]" << std::endl;
+        return -1;
+    }
+    if (maxN < 1000 || fatMargin < 0) {
+        std::cerr << "max N has to be at least 1000 and the fat margin not negative" << std::endl;
+        return -1;
+    }
+
+    if (isJson)
+        std::cout << "[\n";
+    else
+        printCsvHeader();
+    bool isFirst = true;
+    for (int N = 1000; N <= maxN; N *= 10) {
+        for (int capacity : { 4, OctreeNode::CAPACITY, 32 }) {
+            for (Sizes sizes : { Sizes::UNIFORM, Sizes::CLUSTERED, Sizes::MIXED }) {
+                for (Shapes shapes : { Shapes::SPHERES, Shapes::CUBES, Shapes::MIXED }) {
+                    for (const Row& row : run({ N, capacity, sizes, shapes }, seed, fatMargin)) {
+                        if (isJson)
+                            printJson(row, isFirst);
+                        else
+                            printCsv(row);
+                        isFirst = false;
+                    }
+                }
+            }
+        }
+    }
+    if (isJson)
+        std::cout << "\n]" << std::endl;
+
+    return 0;
+}
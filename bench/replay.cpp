@@ -0,0 +1,138 @@
+// replays a trace recorded by the demo (T button) or bench/headless.cpp against a fresh octree, without a GL context,
+// and prints the time of every frame
+// usage: replay trace [capacity] [fat margin] [restructure us] [rebuild]
+// the capacity and the fat margin of the recording by default
+// with a restructure budget, the splits and merges of a frame are deferred and done within that many microseconds at its end
+// with rebuild 1, the octree is rebuilt when its default rebuild policy has it due, by slices within the restructure budget if there is one
+// needs only the octree library, e.g.
+// g++ -std=c++17 -O2 -I../src -I<glm> replay.cpp ../src/trace.cpp ../src/profiler.cpp ../src/octree.cpp ../src/geometry.cpp ../src/body.cpp ../src/narrow_phase.cpp
+
+#include "trace.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <algorithm>
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " trace [capacity] [fat margin] [restructure us] [rebuild]" << std::endl;
+        return -1;
+    }
+    TraceReader trace;
+    if (!trace.open(argv[1]))
+        return -1;
+    int capacity = trace.header.capacity;
+    float fatMargin = trace.header.fatMargin;
+    int restructureBudget = 0;
+    bool isRebuilding = false;
+    try {
+        if (argc > 2)
+            capacity = std::stoi(argv[2]);
+        if (argc > 3)
+            fatMargin = std::stof(argv[3]);
+        if (argc > 4)
+            restructureBudget = std::stoi(argv[4]);
+        if (argc > 5)
+            isRebuilding = std::stoi(argv[5]) != 0;
+    }
+    catch (const std::exception&) {
+        std::cerr << "usage: " << argv[0] << " trace [capacity] [fat margin] [restructure us] [rebuild]" << std::endl;
+        return -1;
+    }
+    if (capacity < 1 || fatMargin < 0 || restructureBudget < 0) {
+        std::cerr << "the capacity has to be positive, and the fat margin and the restructure budget not negative" << std::endl;
+        return -1;
+    }
+
+    if (isProfiling)
+        timeline.start();
+
+    // the recorded poses were committed, i.e. they don't intersect
+    Octree octree(trace.header.maxCoordinate, fatMargin, capacity);
+    if (isRebuilding) {
+        OctreeRebuildPolicy policy;
+        policy.isEnabled = true;
+        octree.setRebuildPolicy(policy);
+    }
+    std::vector<std::unique_ptr<Body>> objects;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& traced : trace.objects) {
+        objects.push_back(std::make_unique<Body>(traced.type));
+        const int id = objects.back()->getID();
+        geometry.elongation[id] = traced.elongation;
+        geometry.setPose(id, traced.pose);
+        octree.insert(objects.back().get(), true);
+    }
+    octree.setDeferring(restructureBudget > 0);
+    std::cout << "N = " << objects.size() << ", node capacity = " << capacity << ", fat margin = " << fatMargin
+        << ", restructure us = " << restructureBudget << ", rebuild = " << isRebuilding << std::endl;
+    std::cout << "insert ms = " << std::fixed << std::setprecision(2) << millisecondsSince(start) << std::endl;
+
+    std::cout
+        << std::setw(8) << "frame"
+        << std::setw(12) << "ms"
+        << std::setw(10) << "moves"
+        << std::setw(10) << "blocked"
+        << std::setw(12) << "leaves/obj"
+        << std::setw(12) << "node KiB"
+        << std::setw(8) << "depth"
+        << std::setw(10) << "splits"
+        << std::setw(10) << "merges"
+        << std::setw(10) << "rebuilt"
+        << std::setw(10) << "pending"
+        << std::endl;
+    octree.resetCounters();
+    std::vector<TraceMove> moves;
+    int frames = 0;
+    double total = 0, worst = 0;
+    while (trace.nextFrame(moves)) {
+        frames++;
+        int blocked = 0;
+        start = std::chrono::steady_clock::now();
+        {
+            ScopedTimer timer(ProfilePhase::FRAME);
+            for (const auto& move : moves)
+                blocked += octree.move(objects[move.index].get(), move.displacement).t < 1.0f;
+            if (octree.isDeferringRestructures())
+                octree.restructure(std::chrono::microseconds(restructureBudget));
+            timer.arg("moves", moves.size());
+            timer.arg("splits", octree.getCounters().splits);
+            timer.arg("merges", octree.getCounters().merges);
+        }
+        const bool isRebuilt = restructureBudget > 0
+            ? octree.maintain(std::chrono::microseconds(restructureBudget)) : octree.maintain();
+        const double time = millisecondsSince(start);
+        total += time;
+        worst = std::max(worst, time);
+
+        octree.publishStats();
+        const OctreeStats stats = octree.stats();
+        std::cout
+            << std::setw(8) << frames
+            << std::setw(12) << time
+            << std::setw(10) << moves.size()
+            << std::setw(10) << blocked
+            << std::setw(12) << stats.duplication()
+            << std::setw(12) << stats.bytes / 1024
+            << std::setw(8) << (int)stats.leavesByDepth.size() - 1
+            << std::setw(10) << stats.counters.splits
+            << std::setw(10) << stats.counters.merges
+            << std::setw(10) << isRebuilt
+            << std::setw(10) << stats.pendingRestructures
+            << std::endl;
+    }
+    if (frames > 0)
+        std::cout << "mean ms = " << total / frames << ", max ms = " << worst << std::endl;
+    if (isProfiling && profiler.writeJson("profile.json") && timeline.writeJson("timeline.json"))
+        std::cout << "profile saved to profile.json and timeline.json" << std::endl;
+
+    return 0;
+}
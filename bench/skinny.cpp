@@ -0,0 +1,120 @@
+// skinny objects against the octree: the same number of capsules of the same volume,
+// more and more elongated, to see how much the spread factor costs, without and with a fat margin
+// needs only the octree library, e.g.
+// cl /std:c++17 /O2 /I..\src /I<glm> skinny.cpp ..\src\profiler.cpp ..\src\octree.cpp ..\src\geometry.cpp ..\src\body.cpp ..\src\narrow_phase.cpp
+
+#include "octree.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <vector>
+
+constexpr float MAX_COORDINATE = 10.0f;
+constexpr int N = 3000;
+constexpr int QUERIES = 100'000;
+// of a capsule with radius 0.3 and no segment, i.e. a sphere
+constexpr float VOLUME = 4.0f / 3 * glm::pi<float>() * 0.3f * 0.3f * 0.3f;
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void run(float elongation, float fatMargin) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> tDist(-MAX_COORDINATE, MAX_COORDINATE);
+    std::uniform_real_distribution<float> aDist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> degreeDist(0.0f, 360.0f);
+    // pi r^3 (4/3 + 2 elongation) = VOLUME
+    const float radius = std::cbrt(VOLUME / (glm::pi<float>() * (4.0f / 3 + 2 * elongation)));
+
+    Octree octree(MAX_COORDINATE, fatMargin);
+    std::vector<std::unique_ptr<Body>> objects;
+    auto makeCapsule = [&] {
+        auto object = std::make_unique<Body>(SolidBodyType::CAPSULE);
+        geometry.elongation[object->getID()] = elongation;
+        object->scale(radius);
+        object->rotate({ aDist(rng), aDist(rng), aDist(rng) + 0.001f }, degreeDist(rng));
+        return object;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    int attempts = 0;
+    while (objects.size() < N && attempts < 100 * N) {
+        attempts++;
+        auto object = makeCapsule();
+        object->translate({ tDist(rng), tDist(rng), tDist(rng) });
+        if (octree.insert(object.get()))
+            objects.push_back(std::move(object));
+    }
+    const double insertTime = millisecondsSince(start);
+
+    // probes of the same volume, in a ring buffer of objects not in the octree
+    std::vector<std::unique_ptr<Body>> probes;
+    for (int i = 0; i < 64; i++)
+        probes.push_back(makeCapsule());
+    start = std::chrono::steady_clock::now();
+    int hits = 0;
+    for (int i = 0; i < QUERIES; i++) {
+        auto& probe = probes[i % probes.size()];
+        glm::vec3 t{ tDist(rng), tDist(rng), tDist(rng) };
+        probe->translate(t);
+        hits += octree.intersects(probe.get());
+        probe->translate(-t);
+    }
+    const double queryTime = millisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    int rayHits = 0;
+    for (int i = 0; i < QUERIES; i++) {
+        glm::vec3 from{ tDist(rng), tDist(rng), tDist(rng) };
+        glm::vec3 to{ tDist(rng), tDist(rng), tDist(rng) };
+        rayHits += octree.rayQuery(from, to).object != nullptr;
+    }
+    const double rayTime = millisecondsSince(start);
+
+    std::cout << std::fixed << std::setprecision(2)
+        << std::setw(10) << elongation
+        << std::setw(8) << fatMargin
+        << std::setw(10) << radius
+        << std::setw(8) << objects.size()
+        << std::setw(12) << (double)octree.registrations() / objects.size()
+        << std::setw(12) << octree.nodeMemoryUsage() / 1024
+        << std::setw(12) << insertTime
+        << std::setw(12) << queryTime * 1000 / QUERIES
+        << std::setw(10) << hits
+        << std::setw(12) << rayTime * 1000 / QUERIES
+        << std::setw(10) << rayHits
+        << std::endl;
+
+    for (auto& object : objects)
+        octree.remove(object.get());
+}
+
+int main() {
+    std::cout << "N = " << N << ", node capacity = " << OctreeNode::CAPACITY << ", same volume per object" << std::endl;
+    std::cout
+        << std::setw(10) << "elongation"
+        << std::setw(8) << "margin"
+        << std::setw(10) << "radius"
+        << std::setw(8) << "objects"
+        << std::setw(12) << "leaves/obj"
+        << std::setw(12) << "node KiB"
+        << std::setw(12) << "insert ms"
+        << std::setw(12) << "query us"
+        << std::setw(10) << "hits"
+        << std::setw(12) << "ray us"
+        << std::setw(10) << "ray hits"
+        << std::endl;
+    // without a fat margin, and with the one of the demo
+    for (float elongation : { 0.0f, 1.0f, 3.0f, 7.0f, 15.0f, 31.0f }) {
+        for (float fatMargin : { 0.0f, 0.1f })
+            run(elongation, fatMargin);
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+// checks that sweeps from a resting contact only hit when approaching, for every pair of shape types:
+// the first object is swept into the second one and stopped at the contact, as Octree::move does,
+// then moved away, which must not hit anything, or on toward the second one, which must
+// away is the approach reversed for every pair, and for a sphere and a cube also any move away from the closest point of the cube,
+// as the distance between convex shapes only grows once it does
+// usage: sweep_contact [contacts per pair] [seed]
+// exits with 1 if any move away hits or any move on misses
+// needs the geometry store, e.g.
+// g++ -std=c++17 -O2 -I../src -I<glm> sweep_contact.cpp ../src/geometry.cpp ../src/body.cpp
+
+#include "body.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+constexpr float SWEEP_MARGIN = 0.02f;
+
+const char* name(SolidBodyType type) {
+    switch (type) {
+    case SolidBodyType::SPHERE:
+        return "sphere";
+    case SolidBodyType::CUBE:
+        return "cube";
+    case SolidBodyType::ORIENTED_CUBE:
+        return "oriented";
+    case SolidBodyType::CAPSULE:
+        return "capsule";
+    }
+    return "";
+}
+
+glm::vec3 randomDirection(std::mt19937& rng) {
+    std::normal_distribution<float> dist;
+    while (true) {
+        glm::vec3 v{ dist(rng), dist(rng), dist(rng) };
+        if (glm::length(v) > 0.001f)
+            return glm::normalize(v);
+    }
+}
+
+void place(Body& body, std::mt19937& rng, const glm::vec3& center) {
+    std::uniform_real_distribution<float> sDist(0.2f, 1.0f);
+    std::uniform_real_distribution<float> dDist(0.0f, 360.0f);
+    body.scale(sDist(rng));
+    if (geometry.type[body.getID()] != SolidBodyType::CUBE)
+        body.rotate(randomDirection(rng), dDist(rng));
+    body.translate(center);
+    if (geometry.type[body.getID()] == SolidBodyType::CAPSULE)
+        geometry.elongation[body.getID()] = 2.0f;
+    body.commit();
+}
+
+// the direction from the closest point of the cube to the center of the sphere, zero if the center is inside
+glm::vec3 awayFromCube(const Body& sphere, const Body& cube) {
+    const int id = cube.getID();
+    glm::vec3 center = geometry.center(sphere.getID());
+    Box box = cube.bounds();
+    glm::mat3 axes(1.0f);
+    if (geometry.type[id] == SolidBodyType::ORIENTED_CUBE) {
+        const OrientedCubeShape shape = geometry.shape<OrientedCubeShape>(id);
+        center = toLocal(shape, center);
+        box = localBox(shape);
+        axes = shape.axes;
+    }
+    glm::vec3 closest;
+    for (int i = 0; i < 3; i++)
+        closest[i] = std::min(std::max(center[i], box.mins[i]), box.maxs[i]);
+    return axes * (center - closest);
+}
+
+int main(int argc, char** argv) {
+    int contacts = 10'000;
+    unsigned int seed = 1;
+    if (argc > 1)
+        contacts = std::atoi(argv[1]);
+    if (argc > 2)
+        seed = std::atoi(argv[2]);
+
+    std::cout << contacts << " contacts per pair, 10 moves on and 10 or 20 away from each" << std::endl;
+    std::cout
+        << std::setw(20) << "pair"
+        << std::setw(12) << "contacts"
+        << std::setw(12) << "misses"
+        << std::setw(12) << "reversed"
+        << std::setw(12) << "hits"
+        << std::setw(12) << "away"
+        << std::setw(12) << "hits"
+        << std::endl;
+
+    bool isAgreeing = true;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uDist(0.0f, 1.0f);
+    for (int type1 = 0; type1 < NUM_SOLID_BODY_TYPES; type1++) {
+        for (int type2 = 0; type2 < NUM_SOLID_BODY_TYPES; type2++) {
+            long long made = 0, misses = 0, reversed = 0, reversedHits = 0, away = 0, awayHits = 0;
+            for (int n = 0; n < contacts; n++) {
+                Body body1((SolidBodyType)type1), body2((SolidBodyType)type2);
+                place(body1, rng, glm::vec3(0.0f));
+                place(body2, rng, randomDirection(rng) * 4.0f);
+                if (body1.intersects(&body2, SWEEP_MARGIN))
+                    continue;
+                // toward somewhere on the other object
+                const glm::vec3 target = geometry.center(body2.getID()) + randomDirection(rng) * 0.3f * uDist(rng);
+                const glm::vec3 approach = (target - geometry.center(body1.getID())) * 1.5f;
+                float t;
+                if (!body1.sweep(approach, &body2, t, SWEEP_MARGIN))
+                    continue;
+                body1.translate(approach * t);
+                body1.commit();
+                made++;
+
+                for (int k = 0; k < 10; k++)
+                    misses += !body1.sweep(approach * (0.01f + uDist(rng)), &body2, t, SWEEP_MARGIN);
+                for (int k = 0; k < 10; k++) {
+                    const glm::vec3 displacement = -approach * (0.001f + uDist(rng));
+                    reversed++;
+                    reversedHits += body1.sweep(displacement, &body2, t, SWEEP_MARGIN);
+                }
+                glm::vec3 normal(0.0f);
+                if (type1 == (int)SolidBodyType::SPHERE && type2 != (int)SolidBodyType::SPHERE && type2 != (int)SolidBodyType::CAPSULE)
+                    normal = awayFromCube(body1, body2);
+                else if (type2 == (int)SolidBodyType::SPHERE && type1 != (int)SolidBodyType::SPHERE && type1 != (int)SolidBodyType::CAPSULE)
+                    normal = -awayFromCube(body2, body1);
+                if (glm::length(normal) == 0)
+                    continue;
+                for (int k = 0; k < 10; k++) {
+                    glm::vec3 displacement = randomDirection(rng);
+                    if (glm::dot(displacement, normal) < 0)
+                        displacement = -displacement;
+                    if (glm::dot(displacement, normal) == 0)
+                        continue;
+                    displacement *= 0.001f + uDist(rng);
+                    away++;
+                    awayHits += body1.sweep(displacement, &body2, t, SWEEP_MARGIN);
+                }
+            }
+            isAgreeing = isAgreeing && misses == 0 && reversedHits == 0 && awayHits == 0;
+            std::cout
+                << std::setw(20) << std::string(name((SolidBodyType)type1)) + "/" + name((SolidBodyType)type2)
+                << std::setw(12) << made
+                << std::setw(12) << misses
+                << std::setw(12) << reversed
+                << std::setw(12) << reversedHits
+                << std::setw(12) << away
+                << std::setw(12) << awayHits
+                << std::endl;
+        }
+    }
+    std::cout << (isAgreeing ? "ok" : "MISMATCH") << std::endl;
+    return isAgreeing ? 0 : 1;
+}
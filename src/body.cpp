@@ -0,0 +1,38 @@
+#include "body.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <cassert>
+
+Body::Body(SolidBodyType type) : id(geometry.add(this, type)) {}
+
+Body::~Body() {
+    geometry.release(id);
+}
+
+void Body::commit() {
+    committed = geometry.pose(id);
+}
+
+void Body::revert() {
+    geometry.setPose(id, committed);
+}
+
+bool Body::hasMoved() const {
+    return geometry.center(id) != committed.center || geometry.extent[id] != committed.extent || geometry.axes[id] != committed.axes;
+}
+
+void Body::scale(float s) {
+    geometry.extent[id] *= s;
+    geometry.setAxes(id, geometry.axes[id]);
+}
+
+void Body::translate(const glm::vec3& t) {
+    geometry.setCenter(id, geometry.center(id) + t);
+}
+
+void Body::rotate(const glm::vec3& axis, float degrees) {
+    assert(geometry.type[id] != SolidBodyType::CUBE);
+    const glm::mat3 rotation = glm::mat3(glm::rotate(glm::radians(degrees), axis));
+    geometry.setAxes(id, rotation * geometry.axes[id]);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "geometry.h"
+
+// what the octree knows of an object: its geometry in the store and the pose it last accepted
+// nothing about rendering, so that the octree doesn't depend on GL
+class Body {
+protected:
+    // geometry is kept in the store, the object is a view of it
+    const int id;
+    // the store holds the proposed pose, this is the one the octree last accepted
+    Pose committed{ glm::vec3(0.0f), 1.0f, glm::mat3(1.0f) };
+public:
+    Body(SolidBodyType type);
+    Body(const Body&) = delete;
+    Body& operator=(const Body&) = delete;
+    virtual ~Body();
+    int getID() const { return id; }
+
+    // scalings, translations and rotations propose a pose, the octree either commits or reverts it
+    virtual void commit();
+    void revert();
+    // whether the proposed pose differs from the committed one
+    bool hasMoved() const;
+
+    void scale(float s);
+    void translate(const glm::vec3& t);
+    // around the center, axis-aligned cubes can't
+    void rotate(const glm::vec3& axis, float degrees);
+
+    // for safety, overestimate the boundary of the object
+    bool intersects(const Body* other, const float MARGIN = 0.01f) const { return geometry.intersects(id, other->id, MARGIN); }
+    // for safety, underestimate the boundary of the object
+    bool intersects(const Box& box, const float MARGIN = -0.000'01f) const { return geometry.intersects(id, box, MARGIN); }
+    // for safety, overestimate the boundary of the object
+    bool containedInBoundary(const Box& box, const float MARGIN = 0.01f) const { return geometry.containedInBoundary(id, box, MARGIN); }
+
+    Box bounds() const { return geometry.bounds(id); }
+    // if returns yes, the object translated by tOut * displacement is the first to touch the other one
+    // objects already touching do not count if they are separating
+    bool sweep(const glm::vec3& displacement, const Body* other, float& tOut, const float MARGIN = 0.02f) const {
+        return geometry.sweep(id, displacement, other->id, tOut, MARGIN);
+    }
+
+    // if returns yes, the intersection is from + [t1Out...t2Out] * (to-from)
+    bool intersects(const glm::vec3& from, const glm::vec3& to, float& t1Out, float& t2Out) const {
+        return geometry.intersects(id, from, to, t1Out, t2Out);
+    }
+};
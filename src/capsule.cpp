@@ -0,0 +1,12 @@
+#include "capsule.h"
+
+std::ostream& operator<<(std::ostream& os, const Capsule& capsule) {
+	auto shape = geometry.shape<CapsuleShape>(capsule.getID());
+	os << capsule.radius() << " (" << shape.a[0] << ',' << shape.a[1] << ',' << shape.a[2] << ")-("
+		<< shape.b[0] << ',' << shape.b[1] << ',' << shape.b[2] << ')';
+	return os;
+}
+
+std::ostream& Capsule::print(std::ostream& os) const {
+	return os << *this;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "object.h"
+
+#include <iostream>
+#include <string>
+
+// along its first axis, rotate it to orient
+class Capsule : public SolidBody {
+public:
+	// the mesh has to be made with the same elongation
+	Capsule(Mesh& mesh, std::mt19937& rng, float elongation) :
+		SolidBody(mesh, rng, SolidBodyType::CAPSULE) {
+		geometry.elongation[id] = elongation;
+	}
+
+	glm::vec3 center() const { return geometry.center(id); }
+	float radius() const { return geometry.extent[id]; }
+	float halfLength() const { return geometry.elongation[id] * geometry.extent[id]; }
+
+	std::ostream& print(std::ostream& os) const override;
+};
+
+std::ostream& operator<<(std::ostream& os, const Capsule& capsule);
\ No newline at end of file
@@ -8,13 +8,15 @@
 class Cube : public SolidBody {
 public:
 	// using SolidBody::SolidBody;
-	Cube(Mesh& mesh, std::mt19937& rng) :
-		SolidBody(mesh, rng, SolidBodyType::CUBE) {}
+	// only oriented cubes can rotate
+	Cube(Mesh& mesh, std::mt19937& rng, bool isOriented = false) :
+		SolidBody(mesh, rng, isOriented ? SolidBodyType::ORIENTED_CUBE : SolidBodyType::CUBE) {}
 
-	Box boundaryCache;
-	const Box& boundary();
-	const glm::vec3& center() const { return worldPos[stateIndex]; }
-	float halfside() const { return scaledFactor[stateIndex]; }
+	Box boundary() const { return geometry.bounds(id); }
+	glm::vec3 center() const { return geometry.center(id); }
+	float halfside() const { return geometry.extent[id]; }
+
+	std::ostream& print(std::ostream& os) const override;
 };
 
 std::ostream& operator<<(std::ostream& os, const Cube& cube);
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "geometry.h"
+
+#include <algorithm>
+#include <cassert>
+
+GeometryStore geometry;
+
+std::array<float, 3> Box::getCenter() const {
+    std::array<float, 3> ret;
+    for (int i = 0; i < 3; i++)
+        ret[i] = (mins[i] + maxs[i]) / 2;
+    return ret;
+}
+
+int GeometryStore::add(Body* body, SolidBodyType type) {
+    if (!freeIds.empty()) {
+        int id = freeIds.back();
+        freeIds.pop_back();
+        x[id] = y[id] = z[id] = 0.0f;
+        extent[id] = 1.0f;
+        elongation[id] = 0.0f;
+        this->type[id] = type;
+        axes[id] = glm::mat3(1.0f);
+        reach[id] = glm::vec3(1.0f);
+        this->body[id] = body;
+        return id;
+    }
+    x.push_back(0.0f);
+    y.push_back(0.0f);
+    z.push_back(0.0f);
+    extent.push_back(1.0f);
+    elongation.push_back(0.0f);
+    this->type.push_back(type);
+    axes.push_back(glm::mat3(1.0f));
+    reach.push_back(glm::vec3(1.0f));
+    this->body.push_back(body);
+    return this->body.size() - 1;
+}
+
+void GeometryStore::release(int id) {
+    body[id] = nullptr;
+    freeIds.push_back(id);
+}
+
+Box GeometryStore::bounds(int id) const {
+    return visit(id, [](const auto& shape) { return ::bounds(shape); });
+}
+
+void GeometryStore::setAxes(int id, const glm::mat3& axes) {
+    this->axes[id] = axes;
+    reach[id] = reachOf(extent[id], axes);
+}
+
+void GeometryStore::setPose(int id, const Pose& pose) {
+    setCenter(id, pose.center);
+    extent[id] = pose.extent;
+    setAxes(id, pose.axes);
+}
+
+bool GeometryStore::intersects(int id, int other, const float MARGIN) const {
+    return visit(id, [&](const auto& shape) {
+        return visit(other, [&](const auto& otherShape) { return intersectss(shape, otherShape, MARGIN); });
+    });
+}
+
+bool GeometryStore::intersects(int id, const Box& box, const float MARGIN) const {
+    return visit(id, [&](const auto& shape) { return intersectss(shape, box, MARGIN); });
+}
+
+bool GeometryStore::containedInBoundary(int id, const Box& box, const float MARGIN) const {
+    return visit(id, [&](const auto& shape) { return containedIn(shape, box, MARGIN); });
+}
+
+bool GeometryStore::sweep(int id, const glm::vec3& displacement, int other, float& tOut, const float MARGIN) const {
+    return visit(id, [&](const auto& shape) {
+        return visit(other, [&](const auto& otherShape) { return sweeps(shape, displacement, otherShape, tOut, MARGIN); });
+    });
+}
+
+bool GeometryStore::intersects(int id, const glm::vec3& from, const glm::vec3& to, float& t1, float& t2) const {
+    return visit(id, [&](const auto& shape) { return intersectss(shape, from, to, t1, t2); });
+}
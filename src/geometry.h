@@ -0,0 +1,102 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "shapes.h"
+
+#include <array>
+#include <cassert>
+#include <cstdlib>
+#include <vector>
+
+class Body;
+
+// what changes when an object moves
+struct Pose {
+    glm::vec3 center;
+    float extent;
+    glm::mat3 axes;
+};
+
+// geometry of all objects as a structure of arrays, indexed by object id,
+// so that narrow-phase tests touch a few contiguous arrays rather than whole objects
+class GeometryStore {
+public:
+    std::vector<float> x, y, z; // of center
+    std::vector<float> extent; // radius of a sphere or a capsule, halfside of a cube
+    std::vector<float> elongation; // half length of the segment of a capsule over its radius, along its first axis
+    std::vector<SolidBodyType> type;
+    // of an oriented object, identity otherwise
+    std::vector<glm::mat3> axes;
+    std::vector<glm::vec3> reach; // cached with axes, see reachOf
+    std::vector<Body*> body;
+
+    int add(Body* body, SolidBodyType type);
+    void release(int id);
+
+    glm::vec3 center(int id) const { return { x[id], y[id], z[id] }; }
+    void setCenter(int id, const glm::vec3& center) { x[id] = center[0]; y[id] = center[1]; z[id] = center[2]; }
+    Box bounds(int id) const;
+    // recomputes the cached reach as well, on every rotation or scaling
+    void setAxes(int id, const glm::mat3& axes);
+    Pose pose(int id) const { return { center(id), extent[id], axes[id] }; }
+    void setPose(int id, const Pose& pose);
+
+    template <typename Shape> Shape shape(int id) const;
+    // calls f with a value of the shape type (only its type matters)
+    // this is where a shape type is turned into a static type, everything else is picked per type at compile time
+    template <typename F> static decltype(auto) visitType(SolidBodyType type, F&& f);
+    // calls f with the shape of the object
+    template <typename F> decltype(auto) visit(int id, F&& f) const {
+        return visitType(type[id], [&](auto tag) { return f(shape<decltype(tag)>(id)); });
+    }
+
+    // for safety, overestimate the boundary of the object
+    bool intersects(int id, int other, const float MARGIN = 0.01f) const;
+    // for safety, underestimate the boundary of the object
+    bool intersects(int id, const Box& box, const float MARGIN = -0.000'01f) const;
+    // for safety, overestimate the boundary of the object
+    bool containedInBoundary(int id, const Box& box, const float MARGIN = 0.01f) const;
+    // if returns yes, the intersection is from + [t1Out...t2Out] * (to-from)
+    bool intersects(int id, const glm::vec3& from, const glm::vec3& to, float& t1Out, float& t2Out) const;
+    // if returns yes, the object translated by tOut * displacement is the first to touch the other one
+    // objects already touching do not count if they are separating
+    bool sweep(int id, const glm::vec3& displacement, int other, float& tOut, const float MARGIN = 0.02f) const;
+private:
+    std::vector<int> freeIds;
+};
+
+template <> inline SphereShape GeometryStore::shape<SphereShape>(int id) const {
+    return { center(id), extent[id] };
+}
+
+template <> inline CubeShape GeometryStore::shape<CubeShape>(int id) const {
+    return { center(id), extent[id] };
+}
+
+template <> inline OrientedCubeShape GeometryStore::shape<OrientedCubeShape>(int id) const {
+    return { center(id), extent[id], axes[id], reach[id] };
+}
+
+template <> inline CapsuleShape GeometryStore::shape<CapsuleShape>(int id) const {
+    const glm::vec3 c = center(id);
+    const glm::vec3 h = axes[id][0] * (elongation[id] * extent[id]);
+    return { c - h, c + h, extent[id] };
+}
+
+template <typename F> decltype(auto) GeometryStore::visitType(SolidBodyType type, F&& f) {
+    switch (type) {
+    case SolidBodyType::CUBE:
+        return f(CubeShape{});
+    case SolidBodyType::ORIENTED_CUBE:
+        return f(OrientedCubeShape{});
+    case SolidBodyType::CAPSULE:
+        return f(CapsuleShape{});
+    case SolidBodyType::SPHERE:
+        return f(SphereShape{});
+    }
+    // every type is listed above, -Wswitch tells of one that is not
+    assert(false);
+    std::abort();
+}
+
+extern GeometryStore geometry;
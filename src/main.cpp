@@ -6,13 +6,17 @@
 #include "window.h"
 #include "camera.h"
 #include "shader.h"
+#include "mesh_triangle.h"
 #include "mesh_sphere.h"
 #include "mesh_cube.h"
-#include "mesh_triangle.h"
-#include "object.h"
+#include "mesh_capsule.h"
 #include "sphere.h"
 #include "cube.h"
+#include "capsule.h"
 #include "octree.h"
+#include "octree_lines.h"
+#include "simulation.h"
+#include "profiler.h"
 
 #include <iostream>
 #include <random>
@@ -22,19 +26,31 @@
 SolidBodyShader shader;
 Window window;
 Camera camera;
-std::mt19937 rng;
-CubeMesh cubeMesh;
 TriangleMesh triangleMesh;
-std::vector<SphereMesh> sphereMesh;
+CubeMesh cubeMesh;
+CapsuleMesh capsuleMesh;
+constexpr int MAX_SUBDIVISION = 4;
+std::vector<SphereMesh> sphereMeshes; // by subdivision
 
 constexpr bool toRecord = false;
 FILE* ffmpeg;
 std::vector<int> ffmpegBuffer;
+// of the moves while T is on, to be replayed with bench/replay.cpp
+const char* TRACE_PATH = "octree.trace";
+// of the latencies of every phase and the timeline of the last frames, on P or at exit
+const char* PROFILE_PATH = "profile.json";
+const char* TIMELINE_PATH = "timeline.json";
 
 constexpr float MAX_COORDINATE = 10.0f;
-Octree octree(MAX_COORDINATE);
-std::vector<std::unique_ptr<SolidBody>> objects;
-std::set<SolidBody*> clickedObjects;
+// objects moving less than this are not restructured in the octree
+constexpr float FAT_MARGIN = 0.1f;
+// of octree work at the end of a frame, the restructures and a rebuild when due
+constexpr std::chrono::microseconds RESTRUCTURE_BUDGET(1000);
+Simulation simulation(MAX_COORDINATE, FAT_MARGIN);
+Octree& octree = simulation.octree;
+// attached only while the octree is shown
+OctreeLines octreeLines;
+std::set<MovingBody*> clickedObjects;
 
 int main() {
     int N = initN();
@@ -51,8 +67,12 @@ int main() {
     initObject(N);
 
     while(!glfwWindowShouldClose(window.glfwWindow) && !window.toClose){
+        ScopedTimer timer(ProfilePhase::FRAME);
         update();
         display();
+        // between frames, nothing is being moved
+        octree.publishStats();
+        simulation.maintain();
         if(toRecord)
             record();
         glfwPollEvents();
@@ -64,7 +84,7 @@ int main() {
 }
 
 int initN() {
-    std::cout << "Octree node capacity = " << OctreeNode::CAPACITY << '\n' << std::endl;
+    std::cout << "Octree node capacity = " << octree.getCapacity() << '\n' << std::endl;
 
     std::cout
         << "Usage\n"
@@ -72,6 +92,8 @@ int initN() {
         << "Left click [with L-shift]: select [add] an object\n"
         << "WASD buttons: move the seleted objects\n"
         << "O button: toggle the structure of the octree\n"
+        << "T button: start/stop recording a trace of the moves\n"
+        << "P button: save the latencies of the phases of a frame (if built with OCTREE_PROFILING=1)\n"
         << "Space: reset the camera\n"
         << "Arrow buttons: move the camera\n"
         << "Right click drag: rotate the camera\n"
@@ -139,20 +161,50 @@ int initGL() {
 
 int initGLSL() {
     shader.init();
-    octree.init();
+    octreeLines.init();
+    if (window.drawsOctree)
+        octreeLines.attach(octree);
 
     return true;
 }
 
 int initObject(int N) {
-    constexpr int MAX_SUBDIVISION = 4;
-    rng = std::mt19937(std::chrono::steady_clock::now().time_since_epoch().count());
+    const unsigned int seed = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::cout << "seed = " << seed << std::endl;
+    std::mt19937& rng = simulation.rng;
+    rng = std::mt19937(seed);
     cubeMesh = CubeMesh(rng);
+    capsuleMesh = CapsuleMesh(rng, Simulation::CAPSULE_ELONGATION);
+    for (int i = 0; i <= MAX_SUBDIVISION; i++)
+        sphereMeshes.push_back(SphereMesh(rng, i));
     triangleMesh = TriangleMesh(rng);
-    for(int i=0; i<=MAX_SUBDIVISION; i++)
-        sphereMesh.push_back(SphereMesh(rng, i));
 
-    makeObjects(N);
+    // the objects are drawn, with finer meshes for larger spheres
+    simulation.bodyFactory = [&rng](SolidBodyType type, float scale) -> std::unique_ptr<MovingBody> {
+        switch (type) {
+        case SolidBodyType::SPHERE: {
+            int subdivision = MAX_SUBDIVISION;
+            float r = 0.5f;
+            while (scale < r && subdivision > 0) {
+                r /= 3;
+                subdivision--;
+            }
+            return std::make_unique<Sphere>(sphereMeshes[subdivision], rng);
+        }
+        case SolidBodyType::CAPSULE:
+            return std::make_unique<Capsule>(capsuleMesh, rng, Simulation::CAPSULE_ELONGATION);
+        case SolidBodyType::CUBE:
+        case SolidBodyType::ORIENTED_CUBE:
+            return std::make_unique<Cube>(cubeMesh, rng, type == SolidBodyType::ORIENTED_CUBE);
+        }
+        return nullptr;
+    };
+    simulation.makeObjects(N);
+    // a rebuild is spread over frames, as are the splits and merges of a frame
+    simulation.setRestructureBudget(RESTRUCTURE_BUDGET);
+    OctreeRebuildPolicy policy;
+    policy.isEnabled = true;
+    octree.setRebuildPolicy(policy);
 
     return true;
 }
@@ -164,102 +216,56 @@ int initMisc() {
         ffmpeg = _popen(FFMPEG_PATH, "wb");
         ffmpegBuffer.resize(window.width * window.height);
     }
+    if (isProfiling)
+        timeline.start();
 
     return true;
 }
 
-void makeObjects(int N) {
-    constexpr float MIN_SCALE = 0.001;
-    constexpr float MAX_SCALE = 1.0;
-
-    std::uniform_real_distribution<float> rDist(MIN_SCALE, MAX_SCALE);
-    std::uniform_real_distribution<float> tDist(-MAX_COORDINATE + MAX_SCALE * 2, MAX_COORDINATE - MAX_SCALE * 2);
-    std::uniform_int_distribution<int> dist(0, 1);
-
-    for (int i = 0; i < N; i++) {
-        while (true) {
-            int type = dist(rng);
-            float scale = rDist(rng);
-            // cube -> 2*2*2 = 8
-            // sphere -> 4/3pi ~ 4
-            if (type == 1)
-                scale /= 1.25f;
-            glm::vec3 trans = { tDist(rng), tDist(rng), tDist(rng) };
-            int subdivision = 4;
-            {
-                float r = 0.5f;
-                while (scale < r && subdivision > 0) {
-                    r /= 3;
-                    subdivision--;
-                }
-            }
-
-            if (type == 0)
-                objects.push_back(std::make_unique<Sphere>(sphereMesh[subdivision], rng));
-            else
-                objects.push_back(std::make_unique<Cube>(cubeMesh, rng));
-            auto object = objects.back().get();
-            object->scale(scale);
-            object->translate(trans);
-
-            // brute-force test
-            //bool ok = true;
-            //for (int j = 0; j < i; j++) {
-            //    if (object->intersects((Sphere*)objects[j].get())) {
-            //        ok = false;
-            //        break;
-            //    }
-            //}
-            //if (!ok)
-            //    continue;
-
-            if (octree.insert(object))
-                break;
-            else
-                objects.pop_back();
-        }
-    }
-
-}
-
 void update() {
     const double t = glfwGetTime();
 
-    camera.move(window, t);
-
-    camera.updateMatrix();
-    window.updateMatrix();
-
-    // an object moves only if it can move, that is,
-    // i) the object does not go out of the boundary
-    // ii) the object does not collide with other objects
+    {
+        ScopedTimer timer(ProfilePhase::CAMERA);
+        camera.move(window, t);
 
-    auto move = [&](SolidBody* object) {
-        object->updatePosition(window, camera, t);
-        if (!octree.update(object)) {
-            object->revert();
-            object->makeRandomMovingDirection(rng);
-        }
-    };
+        camera.updateMatrix();
+        window.updateMatrix();
+    }
 
-    for (auto& object : objects)
-        move(object.get());
+    // the objects being dragged may be asleep
+    for (auto object : clickedObjects)
+        simulation.wake(object, t);
+    MotionInput input;
+    input.randomMoves = window.randomMoves;
+    input.cameraPosition = camera.getPosition();
+    input.cameraRight = camera.getRight();
+    input.cameraUp = camera.getUp();
+    // since the last frame, or since pressed
+    auto held = [&](int key) { return window.isKeyPressed[key] ? float(t - window.tKey[key]) : 0.0f; };
+    input.drag = { held(GLFW_KEY_D) - held(GLFW_KEY_A), held(GLFW_KEY_W) - held(GLFW_KEY_S) };
+    simulation.update(input, t);
 
     for (int key : {GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D})
         window.tKey[key] = t;
 }
 
 void display() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+        ScopedTimer timer(ProfilePhase::DRAW);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // std::cout << clickedObjects.size() << std::endl;
+        // std::cout << clickedObjects.size() << std::endl;
 
-    for (auto& object : objects)
-        object->draw(shader, window.getProjMat(), camera.getViewMat());
+        // made by the body factory of initObject
+        for (auto& object : simulation.objects)
+            static_cast<SolidBody*>(object.get())->draw(shader, window.getProjMat(), camera.getViewMat());
 
-    if(window.drawsOctree)
-        octree.draw(window.getProjMat(), camera.getViewMat());
+        if(window.drawsOctree)
+            octreeLines.draw(window.getProjMat(), camera.getViewMat());
+    }
 
+    ScopedTimer timer(ProfilePhase::SWAP);
     glfwSwapBuffers(window.glfwWindow);
 }
 
@@ -268,7 +274,18 @@ void record() {
     fwrite(ffmpegBuffer.data(), ffmpegBuffer.size() * sizeof(int), 1, ffmpeg);
 }
 
+void writeProfile() {
+    if (!isProfiling) {
+        std::cout << "build with OCTREE_PROFILING=1 to profile" << std::endl;
+        return;
+    }
+    if (profiler.writeJson(PROFILE_PATH) && timeline.writeJson(TIMELINE_PATH))
+        std::cout << "profile saved to " << PROFILE_PATH << " and " << TIMELINE_PATH << std::endl;
+}
+
 void clean() {
+    if (isProfiling)
+        writeProfile();
     glfwTerminate();
     if (toRecord)
         std::cout << _pclose(ffmpeg) << std::endl;
@@ -297,7 +314,7 @@ void mouse_button_callback(GLFWwindow* glfwWindow, int button, int action, int m
         window.isLeftMousePressed = isPressed;
         if (isPressed) {
             auto [near, far] = window.pointToWorld(window.cursorX, window.cursorY, camera);
-            SolidBody* obj = octree.rayQuery(near, far);
+            MovingBody* obj = static_cast<MovingBody*>(octree.rayQuery(near, far).object);
 
             if (obj == nullptr) {
                 if (window.isKeyPressed[GLFW_KEY_LEFT_SHIFT]) {
@@ -371,11 +388,32 @@ void cursor_position_callback(GLFWwindow* glfwWindow, double x, double y) {
 void key_callback(GLFWwindow* glfwWindow, int key, int scancode, int action, int mods) {
     double t = glfwGetTime();
 
-    if (action == GLFW_PRESS && key == GLFW_KEY_O)
+    if (action == GLFW_PRESS && key == GLFW_KEY_O) {
         window.drawsOctree ^= true;
+        if (window.drawsOctree)
+            octreeLines.attach(octree);
+        else
+            octreeLines.detach();
+    }
+
+    if (action == GLFW_PRESS && key == GLFW_KEY_T) {
+        if (simulation.isTracing()) {
+            simulation.stopTrace();
+            std::cout << "trace saved to " << TRACE_PATH << std::endl;
+        }
+        else if (simulation.startTrace(TRACE_PATH))
+            std::cout << "recording a trace" << std::endl;
+    }
 
-    if (action == GLFW_PRESS && key == GLFW_KEY_ENTER)
+    if (action == GLFW_PRESS && key == GLFW_KEY_P)
+        writeProfile();
+
+    if (action == GLFW_PRESS && key == GLFW_KEY_ENTER) {
         window.randomMoves ^= true;
+        if (window.randomMoves)
+            for (auto& object : simulation.objects)
+                simulation.wake(object.get(), t);
+    }
 
     if (action == GLFW_PRESS && key == GLFW_KEY_SPACE)
         camera.reset();
@@ -1,7 +1,7 @@
 #pragma once
 
 #define GLEW_STATIC
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 int main();
@@ -10,12 +10,12 @@ int initN();
 int initGL();
 int initGLSL();
 int initObject(int);
-void makeObjects(int);
 int initMisc();
 
 void update();
 void display();
 void record();
+void writeProfile();
 void clean();
 
 //void window_size_callback(GLFWwindow* window, int newWidth, int newHeight);
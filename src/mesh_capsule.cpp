@@ -0,0 +1,61 @@
+#include "mesh_capsule.h"
+
+CapsuleMesh::CapsuleMesh(std::mt19937& rng, float elongation) :
+    elongation(elongation) {
+    vertices.clear();
+    colors.clear();
+    normals.clear();
+    indices.clear();
+
+    generateMesh(rng);
+    bind();
+}
+
+// two hemispheres joined by a cylinder, as rings of latitude around the x axis
+void CapsuleMesh::generateMesh(std::mt19937& rng) {
+    constexpr float PI = 3.1415926535;
+    constexpr int CAP_RINGS = 8;
+    constexpr int SECTORS = 24;
+
+    // from the tip at +x to the tip at -x, the ring at the equator is doubled to make the cylinder
+    std::vector<std::pair<float, float>> rings; // x, radius
+    for (int i = 0; i <= CAP_RINGS; i++) {
+        float theta = PI / 2 * i / CAP_RINGS;
+        rings.push_back({ elongation + cosf(theta), sinf(theta) });
+    }
+    for (int i = CAP_RINGS; i <= 2 * CAP_RINGS; i++) {
+        float theta = PI / 2 * i / CAP_RINGS;
+        rings.push_back({ -elongation + cosf(theta), sinf(theta) });
+    }
+
+    auto vertex = [&](int ring, int sector) {
+        float phi = 2 * PI * sector / SECTORS;
+        return glm::vec3(rings[ring].first, rings[ring].second * cosf(phi), rings[ring].second * sinf(phi));
+    };
+
+    std::vector<GLfloat> triangles;
+    auto addTriangle = [&](const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& v3) {
+        for (auto& v : { v1, v2, v3 })
+            for (int i = 0; i < 3; i++)
+                triangles.push_back(v[i]);
+    };
+    for (int ring = 0; ring + 1 < (int)rings.size(); ring++) {
+        for (int sector = 0; sector < SECTORS; sector++) {
+            auto v1 = vertex(ring, sector);
+            auto v2 = vertex(ring, sector + 1);
+            auto v3 = vertex(ring + 1, sector);
+            auto v4 = vertex(ring + 1, sector + 1);
+            // counterclockwise seen from outside
+            addTriangle(v1, v3, v2);
+            addTriangle(v2, v3, v4);
+        }
+    }
+
+    generateFromTriangles(triangles);
+
+    std::uniform_real_distribution<float> distribution(0.0, 1.0);
+
+    int n = vertices.size();
+    for (int i = 0; i < n; i++)
+        colors.push_back(distribution(rng));
+}
\ No newline at end of file
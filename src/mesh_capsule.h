@@ -0,0 +1,16 @@
+#pragma once
+#include "mesh.h"
+
+// radius 1, the segment from (-elongation, 0, 0) to (elongation, 0, 0)
+class CapsuleMesh : public Mesh {
+private:
+    float elongation;
+    void generateMesh(std::mt19937& rng) override final;
+public:
+    CapsuleMesh() : Mesh(), elongation(0.0f) {}
+    CapsuleMesh(std::mt19937& rng, float elongation);
+    CapsuleMesh(const CapsuleMesh& other) : Mesh(other), elongation(other.elongation) {}
+    CapsuleMesh(CapsuleMesh&& other) noexcept : Mesh(std::move(other)), elongation(other.elongation) {}
+    CapsuleMesh& operator=(const CapsuleMesh& other) { Mesh::operator=(other); elongation = other.elongation; return *this; }
+    CapsuleMesh& operator=(CapsuleMesh&& other) noexcept { Mesh::operator=(std::move(other)); elongation = other.elongation; return *this; };
+};
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "moving_body.h"
+
+void MovingBody::makeRandomMovingDirection(std::mt19937& rng) {
+    constexpr float speed = 2.0f;
+    std::uniform_real_distribution<float> tDist(-speed, speed);
+    movingDirection = { tDist(rng), tDist(rng), tDist(rng) };
+}
+
+void MovingBody::wake(double t) {
+    isAsleep = false;
+    restingFrames = 0;
+    this->t = t;
+}
+
+glm::vec3 MovingBody::nextDisplacement(const MotionInput& input, double t) {
+    constexpr float speed = 0.5f;
+    const float dist = glm::length(geometry.center(id) - input.cameraPosition);
+    const float sd = speed * dist;
+
+    glm::vec3 trans(0.0f);
+    if (isClicked)
+        trans += (input.cameraRight * input.drag.x + input.cameraUp * input.drag.y) * sd;
+    else if (input.randomMoves) {
+        float dt = t - this->t;
+        trans += movingDirection * dt;
+    }
+
+    this->t = t;
+    return trans;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "body.h"
+
+#include <random>
+
+// what moves the objects in a frame, filled in by the driver from its input, so that the simulation doesn't depend on GL
+struct MotionInput {
+    // the objects not selected move along their directions
+    bool randomMoves{ false };
+    // the selected objects are dragged in the plane of the view, the farther from the camera the faster
+    glm::vec3 cameraPosition{ 0.0f };
+    glm::vec3 cameraRight{ 0.0f }, cameraUp{ 0.0f };
+    // seconds the drag keys have been held since the last frame, right minus left and up minus down
+    glm::vec2 drag{ 0.0f };
+};
+
+// a body that moves around by itself or when dragged, and falls asleep at rest
+class MovingBody : public Body {
+private:
+    double t{ 0 };
+public:
+    glm::vec3 movingDirection{ 0.0f };
+    bool isClicked{ false };
+    // a sleeping object is not moved until woken up
+    bool isAsleep{ false };
+    int restingFrames{ 0 };
+public:
+    MovingBody(SolidBodyType type) : Body(type) {}
+    // how far the object wants to move since the last call
+    glm::vec3 nextDisplacement(const MotionInput& input, double t);
+    // the time asleep doesn't count as moving
+    void wake(double t);
+
+    void makeRandomMovingDirection(std::mt19937& rng);
+};
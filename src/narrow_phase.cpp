@@ -0,0 +1,234 @@
+#include "narrow_phase.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define NARROW_PHASE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// the avx kernel is compiled for avx on its own, the rest of the program does not assume it
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+namespace {
+    // one object against a group of candidates of one shape type
+    // pairs with a sphere compare the squared distance between a point and a box, grown by the radii:
+    // the box extent is extent * boxScale + boxOffset, the radius is extent * radiusScale + radiusOffset
+    // box pairs compare the distance between the centers per axis against extent + radiusOffset
+    struct KernelParams {
+        float x, y, z;
+        bool isBoxPair;
+        float boxScale, boxOffset;
+        float radiusScale, radiusOffset;
+    };
+
+    KernelParams makeParams(int id, SolidBodyType type, const float MARGIN) {
+        KernelParams p{ geometry.x[id], geometry.y[id], geometry.z[id], false, 0.0f, 0.0f, 1.0f, 0.0f };
+        float e = geometry.extent[id];
+        bool isQueryCube = geometry.type[id] == SolidBodyType::CUBE;
+        if (isQueryCube && type == SolidBodyType::CUBE) {
+            p.isBoxPair = true;
+            p.radiusOffset = e + MARGIN;
+        }
+        else if (type == SolidBodyType::CUBE) {
+            // the query sphere against the candidate boxes
+            p.boxScale = 1.0f;
+            p.radiusScale = 0.0f;
+            p.radiusOffset = e + MARGIN;
+        }
+        else if (isQueryCube) {
+            // the candidate spheres against the query box
+            p.boxOffset = e;
+            p.radiusOffset = MARGIN;
+        }
+        else
+            p.radiusOffset = e + MARGIN;
+        return p;
+    }
+
+    unsigned int scalarKernel(const KernelParams& p, const float* xs, const float* ys, const float* zs, const float* es, int size) {
+        unsigned int mask = 0;
+        for (int i = 0; i < size; i++) {
+            float dx = std::abs(xs[i] - p.x);
+            float dy = std::abs(ys[i] - p.y);
+            float dz = std::abs(zs[i] - p.z);
+            float r = es[i] * p.radiusScale + p.radiusOffset;
+            bool hit;
+            if (p.isBoxPair)
+                hit = dx < r && dy < r && dz < r;
+            else {
+                float b = es[i] * p.boxScale + p.boxOffset;
+                float gx = std::max(dx - b, 0.0f);
+                float gy = std::max(dy - b, 0.0f);
+                float gz = std::max(dz - b, 0.0f);
+                hit = gx * gx + gy * gy + gz * gz < r * r;
+            }
+            if (hit)
+                mask |= 1u << i;
+        }
+        return mask;
+    }
+
+#ifdef NARROW_PHASE_X86
+    unsigned int sseKernel(const KernelParams& p, const float* xs, const float* ys, const float* zs, const float* es, int size) {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        const __m128 zero = _mm_setzero_ps();
+        __m128 px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y), pz = _mm_set1_ps(p.z);
+        __m128 boxScale = _mm_set1_ps(p.boxScale), boxOffset = _mm_set1_ps(p.boxOffset);
+        __m128 radiusScale = _mm_set1_ps(p.radiusScale), radiusOffset = _mm_set1_ps(p.radiusOffset);
+        unsigned int mask = 0;
+        for (int i = 0; i < size; i += 4) {
+            __m128 e = _mm_load_ps(es + i);
+            __m128 dx = _mm_and_ps(_mm_sub_ps(_mm_load_ps(xs + i), px), absMask);
+            __m128 dy = _mm_and_ps(_mm_sub_ps(_mm_load_ps(ys + i), py), absMask);
+            __m128 dz = _mm_and_ps(_mm_sub_ps(_mm_load_ps(zs + i), pz), absMask);
+            __m128 r = _mm_add_ps(_mm_mul_ps(e, radiusScale), radiusOffset);
+            __m128 hit;
+            if (p.isBoxPair)
+                hit = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(dx, r), _mm_cmplt_ps(dy, r)), _mm_cmplt_ps(dz, r));
+            else {
+                __m128 b = _mm_add_ps(_mm_mul_ps(e, boxScale), boxOffset);
+                __m128 gx = _mm_max_ps(_mm_sub_ps(dx, b), zero);
+                __m128 gy = _mm_max_ps(_mm_sub_ps(dy, b), zero);
+                __m128 gz = _mm_max_ps(_mm_sub_ps(dz, b), zero);
+                __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), _mm_mul_ps(gz, gz));
+                hit = _mm_cmplt_ps(dist2, _mm_mul_ps(r, r));
+            }
+            mask |= (unsigned int)_mm_movemask_ps(hit) << i;
+        }
+        return mask;
+    }
+
+    TARGET_AVX
+    unsigned int avxKernel(const KernelParams& p, const float* xs, const float* ys, const float* zs, const float* es, int size) {
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 px = _mm256_set1_ps(p.x), py = _mm256_set1_ps(p.y), pz = _mm256_set1_ps(p.z);
+        __m256 boxScale = _mm256_set1_ps(p.boxScale), boxOffset = _mm256_set1_ps(p.boxOffset);
+        __m256 radiusScale = _mm256_set1_ps(p.radiusScale), radiusOffset = _mm256_set1_ps(p.radiusOffset);
+        unsigned int mask = 0;
+        for (int i = 0; i < size; i += 8) {
+            __m256 e = _mm256_load_ps(es + i);
+            __m256 dx = _mm256_and_ps(_mm256_sub_ps(_mm256_load_ps(xs + i), px), absMask);
+            __m256 dy = _mm256_and_ps(_mm256_sub_ps(_mm256_load_ps(ys + i), py), absMask);
+            __m256 dz = _mm256_and_ps(_mm256_sub_ps(_mm256_load_ps(zs + i), pz), absMask);
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(e, radiusScale), radiusOffset);
+            __m256 hit;
+            if (p.isBoxPair)
+                hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(dx, r, _CMP_LT_OQ), _mm256_cmp_ps(dy, r, _CMP_LT_OQ)),
+                    _mm256_cmp_ps(dz, r, _CMP_LT_OQ));
+            else {
+                __m256 b = _mm256_add_ps(_mm256_mul_ps(e, boxScale), boxOffset);
+                __m256 gx = _mm256_max_ps(_mm256_sub_ps(dx, b), zero);
+                __m256 gy = _mm256_max_ps(_mm256_sub_ps(dy, b), zero);
+                __m256 gz = _mm256_max_ps(_mm256_sub_ps(dz, b), zero);
+                __m256 dist2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy)), _mm256_mul_ps(gz, gz));
+                hit = _mm256_cmp_ps(dist2, _mm256_mul_ps(r, r), _CMP_LT_OQ);
+            }
+            mask |= (unsigned int)_mm256_movemask_ps(hit) << i;
+        }
+        return mask;
+    }
+
+    bool hasAvx() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] >> 27) & 1;
+        bool avx = (info[2] >> 28) & 1;
+        // the os has to save the ymm registers too
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#elif defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx");
+#else
+        return false;
+#endif
+    }
+#endif
+
+    using Kernel = unsigned int (*)(const KernelParams&, const float*, const float*, const float*, const float*, int);
+
+    Kernel kernel() {
+        static const Kernel k = [] {
+            switch (simdLevel()) {
+#ifdef NARROW_PHASE_X86
+            case SimdLevel::AVX:
+                return (Kernel)avxKernel;
+            case SimdLevel::SSE:
+                return (Kernel)sseKernel;
+#endif
+            default:
+                return (Kernel)scalarKernel;
+            }
+        }();
+        return k;
+    }
+}
+
+SimdLevel simdLevel() {
+#ifdef NARROW_PHASE_X86
+    // sse2 is part of x86-64
+    static const SimdLevel level = hasAvx() ? SimdLevel::AVX : SimdLevel::SSE;
+    return level;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+void CandidateBatch::add(int id) {
+    auto& group = groups[(int)geometry.type[id]];
+    assert(group.size < MAX_SIZE);
+    int i = group.size++;
+    group.ids[i] = id;
+    group.x[i] = geometry.x[id];
+    group.y[i] = geometry.y[id];
+    group.z[i] = geometry.z[id];
+    group.extent[i] = geometry.extent[id];
+}
+
+void CandidateBatch::clear() {
+    for (auto& group : groups)
+        group.size = 0;
+}
+
+bool CandidateBatch::isFull() const {
+    for (auto& group : groups)
+        if (group.size == MAX_SIZE)
+            return true;
+    return false;
+}
+
+unsigned int CandidateBatch::hitMask(int id, SolidBodyType type, const float MARGIN) const {
+    auto& group = groups[(int)type];
+    if (group.size == 0)
+        return 0;
+    if (!hasKernel(type) || !hasKernel(geometry.type[id])) {
+        unsigned int mask = 0;
+        for (int i = 0; i < group.size; i++)
+            if (geometry.intersects(id, group.ids[i], MARGIN))
+                mask |= 1u << i;
+        return mask;
+    }
+    KernelParams p = makeParams(id, type, MARGIN);
+    unsigned int mask = kernel()(p, group.x.data(), group.y.data(), group.z.data(), group.extent.data(), group.size);
+    // lanes past the size hold stale candidates
+    if (group.size < MAX_SIZE)
+        mask &= (1u << group.size) - 1;
+    return mask;
+}
+
+bool CandidateBatch::intersects(int id, const float MARGIN) const {
+    for (int type = 0; type < (int)groups.size(); type++)
+        if (hitMask(id, (SolidBodyType)type, MARGIN) != 0)
+            return true;
+    return false;
+}
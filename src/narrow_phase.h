@@ -0,0 +1,39 @@
+#pragma once
+#include "geometry.h"
+
+#include <array>
+
+// the instruction sets the narrow-phase kernels are built for, picked once at run time
+enum class SimdLevel {
+    SCALAR,
+    SSE,
+    AVX,
+};
+
+SimdLevel simdLevel();
+
+// candidates of a leaf scan, gathered from the store and grouped by shape type,
+// so that one object is tested against a whole group at once by a vectorized kernel
+// spheres and cubes have kernels, pairs with the other shapes are tested one by one
+class CandidateBatch {
+public:
+    static constexpr int MAX_SIZE = 32;
+
+    void add(int id);
+    void clear();
+    bool isFull() const;
+
+    // bit i of the result is set if the object intersects the i-th candidate of the given type
+    unsigned int hitMask(int id, SolidBodyType type, const float MARGIN = 0.01f) const;
+    static bool hasKernel(SolidBodyType type) { return type == SolidBodyType::SPHERE || type == SolidBodyType::CUBE; }
+    // for safety, overestimate the boundary of the object
+    bool intersects(int id, const float MARGIN = 0.01f) const;
+private:
+    struct Group {
+        // padded to a whole number of vectors, lanes past size are masked out
+        alignas(32) std::array<float, MAX_SIZE> x{}, y{}, z{}, extent{};
+        std::array<int, MAX_SIZE> ids;
+        int size{ 0 };
+    };
+    std::array<Group, NUM_SOLID_BODY_TYPES> groups; // indexed by SolidBodyType
+};
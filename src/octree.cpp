@@ -1,160 +1,181 @@
 #include "octree.h"
+#include "profiler.h"
 
 #include <iostream>
+#include <algorithm>
+#include <xmmintrin.h>
 
-OctreeNode::OctreeNode(const std::array<float, 3>& center, const Box& boundary, int nodeID, int vIndex, std::vector<OctreeNode*>& nodeList)
-    : center(center), boundary(boundary), nodeID(nodeID), vIndex(vIndex), subBoxes(makeSubBoxes(center, boundary)) {
-    nodeList.push_back(this);
+Box OctreeNode::boundary() const {
+    return Box(center[0] - halfSize, center[1] - halfSize, center[2] - halfSize,
+        center[0] + halfSize, center[1] + halfSize, center[2] + halfSize);
 }
 
-std::array<Box, 1 << 3> OctreeNode::makeSubBoxes(const std::array<float, 3>& center, const Box& boundary) {
-    std::array<Box, 1 << 3> subBoxes;
-    for (int mask = 0; mask < 1 << 3; mask++) {
-        for (int pos = 0; pos < 3; pos++) {
-            if (mask & (1 << pos)) {
-                subBoxes[mask].mins[pos] = boundary.mins[pos];
-                subBoxes[mask].maxs[pos] = center[pos];
-            }
-            else {
-                subBoxes[mask].mins[pos] = center[pos];
-                subBoxes[mask].maxs[pos] = boundary.maxs[pos];
-            }
+Box OctreeNode::subBox(int i) const {
+    Box box;
+    for (int pos = 0; pos < 3; pos++) {
+        if (i & (1 << pos)) {
+            box.mins[pos] = center[pos] - halfSize;
+            box.maxs[pos] = center[pos];
+        }
+        else {
+            box.mins[pos] = center[pos];
+            box.maxs[pos] = center[pos] + halfSize;
         }
     }
-    return subBoxes;
+    return box;
 }
 
-std::array<float, 3> Box::getCenter() const {
-    std::array<float, 3> ret;
-    for (int i = 0; i < 3; i++)
-        ret[i] = (mins[i] + maxs[i]) / 2;
-    return ret;
+// leaves keep their objects sorted by shape type (then id),
+// so that a leaf scan runs through each shape type at once
+static bool byShape(int id1, int id2) {
+    return std::make_pair(geometry.type[id1], id1) < std::make_pair(geometry.type[id2], id2);
 }
 
-OctreeNode* Octree::makeNode(const std::array<float, 3>& center, const Box& boundary) {
-    const auto& mins = boundary.mins;
-    const auto& maxs = boundary.maxs;
-    bool isModifying;
-    int vIndex;
-    if (deletedVIndex.empty()) {
-        isModifying = false;
-        vIndex = newVIndex;
-        newVIndex += 18 * 3;
+// sorts the children to explore by their entry parameters
+// an insertion sort, as there are at most 8 (std::sort on the fixed array trips -Warray-bounds)
+template <typename T>
+static void sortChildren(T* children, int count) {
+    for (int i = 1; i < count; i++) {
+        for (int j = i; j > 0 && children[j] < children[j - 1]; j--)
+            std::swap(children[j], children[j - 1]);
     }
-    else {
-        isModifying = true;
-        vIndex = deletedVIndex.back();
-        deletedVIndex.pop_back();
-    }
-    int nodeID = nodeList.size();
-
-    // when appending the vertices to the end
-    // vIndex = 8 * 3 + nodeID * 18 * 3; // 6 + 4*3 = 18 new vertices
-    int offset = 0;
-    auto updateVertexBuffer = [&](const std::array<float, 3>& vertex) {
-        if (isModifying) {
-            insertVertex(vIndex + offset, vertex);
-            offset += 3;
-        }
-        else
-            addVertex(vertex);
-    };
+}
 
-    // center lines
-    for (int i = 0; i < 3; i++) {
-        std::array<float, 3> vertexMin, vertexMax;
-        for (int j = 0; j < 3; j++) {
-            if (i == j) {
-                vertexMin[j] = mins[j];
-                vertexMax[j] = maxs[j];
-            }
-            else {
-                vertexMin[j] = center[j];
-                vertexMax[j] = center[j];
-            }
-        }
-        updateVertexBuffer(vertexMin);
-        updateVertexBuffer(vertexMax);
+// calls f(id, shape) for the objects of a leaf, a run of one shape type at a time,
+// so that f is instantiated per shape type and its loop does not branch on the type
+template <typename F>
+void forEachShape(const std::vector<int>& objects, F f) {
+    for (auto first = objects.begin(); first != objects.end();) {
+        SolidBodyType type = geometry.type[*first];
+        auto last = std::find_if(first, objects.end(), [&](int id) { return geometry.type[id] != type; });
+        GeometryStore::visitType(type, [&](auto tag) {
+            for (auto it = first; it != last; ++it)
+                f(*it, geometry.shape<decltype(tag)>(*it));
+        });
+        first = last;
     }
+}
 
-    // boundary lines
-    std::array<int, 4> masks{ 0, 1, 3, 2 };
-    for (int i = 0; i < 3; i++) {
-        std::array<float, 3> vertex;
-        for(int mask: masks){
-            int pos = 0;
-            for (int j = 0; j < 3; j++) {
-                if(i == j){
-                    vertex[j] = center[i];
-                }
-                else {
-                    if (mask & (1 << pos++))
-                        vertex[j] = mins[j];
-                    else
-                        vertex[j] = maxs[j];
-                }
-            }
-            updateVertexBuffer(vertex);
-        }
-    }
+void Octree::makeNode(OctreeNode* node, const std::array<float, 3>& center, float halfSize) {
+    node->center = center;
+    node->halfSize = halfSize;
+    node->nodeID = nodeList.size();
+    nodeList.push_back(node);
+    if (observer != nullptr)
+        observer->nodeAdded(node);
+}
 
-    // here, we care about # of vertices, not # of vertice coordinates
-    vIndex /= 3;
-    for (int i = 0; i < 6; i+=2) {
-        addIndex(vIndex + i);
-        addIndex(vIndex + i + 1);
-    }
-    for (int i = 6; i < 18; i += 4) {
-        for (int j = i; j < i + 3; j++) {
-            addIndex(vIndex + j);
-            addIndex(vIndex + j + 1);
-        }
-        addIndex(vIndex + i + 3);
-        addIndex(vIndex + i);
-    }
+void Octree::makeRoot() {
+    root = new OctreeNode();
+    makeNode(root, boundary.getCenter(), boundary.maxs[0] - boundary.getCenter()[0]);
+}
 
-    return new OctreeNode(center, boundary, nodeID, vIndex, nodeList);
+OctreeNode* Octree::makeChild(OctreeNode* node, int i) {
+    if (node->children == nullptr)
+        node->children = new OctreeNode[1 << 3];
+    node->childMask |= 1 << i;
+    OctreeNode* child = &node->children[i];
+    makeNode(child, node->subBox(i).getCenter(), node->halfSize / 2);
+    return child;
+}
+
+// the child has to be cleaned already
+void Octree::releaseChild(OctreeNode* node, int i) {
+    node->childMask &= ~(1 << i);
+    node->children[i] = OctreeNode();
+    if (node->childMask == 0) {
+        delete[] node->children;
+        node->children = nullptr;
+    }
 }
 
-int dbgcnt = 0;
 // assumption: node's boundary intersects with object
-void Octree::insert(OctreeNode* node, SolidBody* object) {
-    dbgcnt++;
+void Octree::insert(OctreeNode* node, int id) {
+    counters.nodesVisited++;
+    node->isContentDirty = true;
+    node->count++;
 
-    // go down and make node if necessary
-    auto explore = [&](SolidBody* object) {
-        for (int i = 0; i < 1 << 3; i++) {
-            auto& box = node->subBoxes[i];
-            if (object->intersects(box)) {
-                if (node->children[i] == nullptr)
-                    node->children[i] = makeNode(box.getCenter(), box);
-                insert(node->children[i], object);
-            }
+    if (isLeaf(node)) {
+        assert(node->count == (int)node->objects.size() + 1);
+        node->objects.insert(std::lower_bound(node->objects.begin(), node->objects.end(), id, byShape), id);
+
+        // queued already, it is split or not once dequeued
+        if (node->isQueued || fitsInLeaf(node))
+            return;
+        if (isDeferring)
+            defer(node);
+        else
+            split(node);
+    }
+    else {
+        const unsigned int mask = pushDown(node, id);
+        // the objects stop being parted only if a child the object went down to now holds them all
+        bool isHeldByChild = false;
+        for (int i = 0; i < 1 << 3; i++)
+            isHeldByChild = isHeldByChild || ((mask & (1 << i)) && node->child(i)->count == node->count);
+        if (isHeldByChild && fitsInLeaf(node)) {
+            if (isDeferring)
+                defer(node);
+            else
+                collapse(node);
         }
-    };
+    }
+}
 
-    if (node->isLeaf()) {
-        assert(node->count == node->objects.size());
-        node->count++;
-        node->objects.insert(object);
+// go down and make children if necessary, returns the children the object went down to
+unsigned int Octree::pushDown(OctreeNode* node, int id) {
+    const unsigned int mask = registeredChildren(node, id);
+    for (int i = 0; i < 1 << 3; i++) {
+        if (mask & (1 << i)) {
+            auto child = node->child(i);
+            if (child == nullptr)
+                child = makeChild(node, i);
+            insert(child, id);
+        }
+    }
+    return mask;
+}
 
-        if (node->isLeaf())
-            return;
-        else {
-            // have to push down all objects
-            for (auto object : node->objects)
-                explore(object);
-            node->objects.clear();
+// the objects are pushed down a level at once, into lists made to size, and the children that do not fit in a leaf
+// are split in turn (or queued while deferring), the same nodes as pushing the objects down one by one
+void Octree::split(OctreeNode* node) {
+    counters.splits++;
+    std::array<int, 1 << 3> childCounts{};
+    std::vector<unsigned char> masks(node->objects.size());
+    for (size_t k = 0; k < node->objects.size(); k++) {
+        masks[k] = registeredChildren(node, node->objects[k]);
+        for (int i = 0; i < 1 << 3; i++)
+            childCounts[i] += (masks[k] >> i) & 1;
+    }
+    for (int i = 0; i < 1 << 3; i++) {
+        if (childCounts[i] > 0)
+            makeChild(node, i)->objects.reserve(childCounts[i]);
+    }
+    // in the order of node, so sorted as well
+    for (size_t k = 0; k < node->objects.size(); k++) {
+        for (int i = 0; i < 1 << 3; i++) {
+            if (masks[k] & (1 << i))
+                node->child(i)->objects.push_back(node->objects[k]);
         }
     }
-    else {
-        node->count++;
-        explore(object);
+    node->objects = std::vector<int>();
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child == nullptr)
+            continue;
+        child->count = child->objects.size();
+        if (fitsInLeaf(child))
+            continue;
+        if (isDeferring)
+            defer(child);
+        else
+            split(child);
     }
 }
 
-bool Octree::insert(SolidBody* object, bool isSafe){
-    dbgcnt = 0;
+bool Octree::insert(Body* object, bool isSafe){
+    ScopedTimer timer(ProfilePhase::OCTREE_INSERT);
+    counters.inserts++;
     if (objects.count(object)) {
         std::cerr << "the object had already been added" << std::endl;
         return false;
@@ -166,129 +187,381 @@ bool Octree::insert(SolidBody* object, bool isSafe){
             return false;
     }
 
-    if (root == nullptr)
-        root = makeNode({ 0.0f, 0.0f, 0.0f }, boundary);
-    insert(root, object);
+    if (root == nullptr) {
+        makeRoot();
+    }
+    setRegisteredBounds(object);
+    insert(root, object->getID());
+    if (shadow != nullptr) {
+        if (shadow->root == nullptr)
+            shadow->makeRoot();
+        shadow->setRegisteredBounds(object);
+        shadow->insert(shadow->root, object->getID());
+    }
 
     objects.insert(object);
-    isDirty = true;
+    object->commit();
 
     return true;
 }
 
-bool Octree::intersects(OctreeNode* node, SolidBody* object) {
-    dbgcnt++;
-    if (!object->intersects(node->boundary, 0.01f))
+bool Octree::intersects(OctreeNode* node, int id) {
+    counters.nodesVisited++;
+    if (!intersectss(geometry.bounds(id), content(node), 0.01f))
         return false;
-    if (node->isLeaf()) {
-        for (auto object2 : node->objects) {
-            if(object2 != object && object2->intersects(object))
-                return true;
+    if (isLeaf(node)) {
+        // the whole leaf is tested at once, by shape type
+        batch.clear();
+        for (int id2 : node->objects) {
+            if (id2 == id || !untestedLanes(id2, 1))
+                continue;
+            batch.add(id2);
+            counters.narrowTests++;
+            if (batch.isFull()) {
+                if (batch.intersects(id))
+                    return true;
+                batch.clear();
+            }
         }
-        return false;
+        return batch.intersects(id);
     }
     else {
         for (int i = 0; i < 1 << 3; i++) {
-            if (node->children[i] == nullptr)
+            auto child = node->child(i);
+            if (child == nullptr)
                 continue;
-            if (intersects(node->children[i], object))
+            if (intersects(child, id))
                 return true;
         }
         return false;
     }
 }
 
-bool Octree::intersects(SolidBody* object) {
-    dbgcnt = 0;
+bool Octree::intersects(Body* object) {
+    ScopedTimer timer(ProfilePhase::OCTREE_INTERSECTS);
     if (root == nullptr)
         return false;
-    return intersects(root, object);
+    newQuery();
+    return intersects(root, object->getID());
 }
 
-// assumption: from will not be used after this
-void merge(std::unordered_set<SolidBody*>& to, std::unordered_set<SolidBody*>& from) {
-    if (to.size() < from.size())
-        std::swap(from, to);
-    // to.size >= from.size
-    to.insert(from.begin(), from.end());
+constexpr float SWEEP_MARGIN = 0.02f;
+
+// children are visited in the order the center of the object enters them, inflated by the size of the object
+// and pruned once they are entered after the first hit so far
+void Octree::sweep(OctreeNode* node, int id, const glm::vec3& displacement, SweepHit& hit) {
+    counters.nodesVisited++;
+    if (isLeaf(node)) {
+        sweepLeaf(node, id, displacement, hit);
+        return;
+    }
+
+    const Box bounds = geometry.bounds(id);
+    const std::array<float, 3> center = bounds.getCenter();
+    const glm::vec3 from{ center[0], center[1], center[2] };
+    std::array<std::pair<float, OctreeNode*>, 1 << 3> childrenToExplore;
+    int numChildren = 0;
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child == nullptr)
+            continue;
+        Box box = content(child);
+        for (int j = 0; j < 3; j++) {
+            box.mins[j] -= center[j] - bounds.mins[j] + SWEEP_MARGIN;
+            box.maxs[j] += center[j] - bounds.mins[j] + SWEEP_MARGIN;
+        }
+        float t1, t2;
+        if (intersectss(box, from, from + displacement, t1, t2) && t1 < hit.t)
+            childrenToExplore[numChildren++] = { t1, child };
+    }
+    sortChildren(childrenToExplore.data(), numChildren);
+    for (int i = 0; i < numChildren; i++) {
+        if (childrenToExplore[i].first >= hit.t)
+            break;
+        sweep(childrenToExplore[i].second, id, displacement, hit);
+    }
 }
 
-void merge(std::unordered_set<SolidBody*>& to, std::unordered_set<SolidBody*>&& from) {
-    merge(to, from);
+void Octree::sweepLeaf(OctreeNode* node, int id, const glm::vec3& displacement, SweepHit& hit) {
+    geometry.visit(id, [&](const auto& shape) {
+        forEachShape(node->objects, [&](int id2, const auto& otherShape) {
+            if (id2 == id || !untestedLanes(id2, 1))
+                return;
+            counters.narrowTests++;
+            float t;
+            if (sweeps(shape, displacement, otherShape, t, SWEEP_MARGIN) && t < hit.t) {
+                hit.t = t;
+                hit.object = geometry.body[id2];
+            }
+        });
+    });
 }
 
-// remove all nodes under node
-// overwrite the vbo and ibo
-// -- move the last vertices and indices
-std::unordered_set<SolidBody*> Octree::clean(OctreeNode* node) {
-    dbgcnt++;
-    int iIndex = node->nodeID * 15 * 2 + 12 * 2;
-    deletedVIndex.push_back(indices[iIndex] * 3);
-    if (nodeList.back() == node) {
-        assert(iIndex + 15 * 2 == indices.size());
-        nodeList.pop_back();
-        for (int i = 0; i < 15 * 2; i++)
-            indices.pop_back();
+// an object that can touch the sweep shares a leaf with it, as both are registered by their fat bounds
+void Octree::sweepRegistered(OctreeNode* node, int id, const glm::vec3& displacement, SweepHit& hit) {
+    counters.nodesVisited++;
+    if (isLeaf(node)) {
+        sweepLeaf(node, id, displacement, hit);
+        return;
     }
-    else {
-        auto node2 = nodeList.back();
-        nodeList.pop_back();
+    const unsigned int mask = registeredChildren(node, id);
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child != nullptr && (mask & (1 << i)))
+            sweepRegistered(child, id, displacement, hit);
+    }
+}
+
+SweepHit Octree::sweep(Body* object, const glm::vec3& displacement) {
+    ScopedTimer timer(ProfilePhase::OCTREE_SWEEP);
+    SweepHit hit;
+    if (displacement == glm::vec3(0.0f))
+        return hit;
+
+    // the boundary first: the object has to stay inside of it
+    const Box bounds = object->bounds();
+    for (int i = 0; i < 3; i++) {
+        float t = 1.0f;
+        if (displacement[i] > 0)
+            t = (boundary.maxs[i] - SWEEP_MARGIN - bounds.maxs[i]) / displacement[i];
+        else if (displacement[i] < 0)
+            t = (boundary.mins[i] + SWEEP_MARGIN - bounds.mins[i]) / displacement[i];
+        hit.t = std::min(hit.t, std::max(t, 0.0f));
+    }
+
+    if (root == nullptr)
+        return hit;
+    newQuery();
+    // within its fat bounds, only the leaves the object is registered in are swept
+    if (fatMargin > 0) {
+        // a little more than the margin, so that a touching object overlaps one of those leaves by more than rounding
+        constexpr float INSIDE = SWEEP_MARGIN + 0.000'1f;
+        if (staysRegistered(object->getID(), bounds, displacement * hit.t, INSIDE)) {
+            sweepRegistered(root, object->getID(), displacement, hit);
+            return hit;
+        }
+    }
+    sweep(root, object->getID(), displacement, hit);
+    return hit;
+}
+
+SweepHit Octree::move(Body* object, const glm::vec3& displacement) {
+    ScopedTimer timer(ProfilePhase::OCTREE_MOVE);
+    SweepHit hit = sweep(object, displacement);
+    if (hit.t > 0.0f) {
+        object->translate(displacement * hit.t);
+        // short of the boundary and of every object by the sweep margin, unless it stopped at one of them
+        if (!update(object, hit.object == nullptr))
+            hit.t = 0.0f;
+    }
+    return hit;
+}
+
+// objects can be in several children
+void merge(std::vector<int>& to, std::vector<int>&& from) {
+    to.insert(to.end(), from.begin(), from.end());
+    std::sort(to.begin(), to.end(), byShape);
+    to.erase(std::unique(to.begin(), to.end()), to.end());
+}
+
+void erase(std::vector<int>& objects, int id) {
+    auto it = std::find(objects.begin(), objects.end(), id);
+    if (it == objects.end())
+        return;
+    objects.erase(it);
+}
+
+// remove all nodes under node
+// -- move the last node in nodeList to its place
+std::vector<int> Octree::clean(OctreeNode* node) {
+    counters.nodesVisited++;
+    if (observer != nullptr)
+        observer->nodeRemoved(node);
+    auto node2 = nodeList.back();
+    nodeList.pop_back();
+    if (node2 != node) {
         nodeList[node->nodeID] = node2;
         node2->nodeID = node->nodeID;
-        // 3 + 4*3 = 15 lines per center
-        for (int i = 15 * 2 - 1; i >= 0; i--) {
-            indices[iIndex + i] = indices.back();
-            indices.pop_back();
-        }
     }
     for (int i = 0; i < 1 << 3; i++) {
-        if (node->children[i] == nullptr)
+        auto child = node->child(i);
+        if (child == nullptr)
             continue;
-        merge(node->objects, clean(node->children[i]));
+        merge(node->objects, clean(child));
+        releaseChild(node, i);
     }
-    std::unordered_set<SolidBody*> res;
+    std::vector<int> res;
     std::swap(res, node->objects);
-    delete node;
     return res;
 }
 
-// if true, the node had been deleted
-bool Octree::remove(OctreeNode* node, SolidBody* object) {
-    dbgcnt++;
-    if (!object->intersects(node->boundary))
-        return false;
+bool Octree::parts(const std::array<int, 1 << 3>& childCounts, int count) {
+    int most = 0, sum = 0;
+    for (int childCount : childCounts) {
+        most = std::max(most, childCount);
+        sum += childCount;
+    }
+    return most < count || sum == count;
+}
 
-    // now assume that object had been added to node
-    if (node->isLeaf()) {
-        assert(node->count == node->objects.size());
-        node->count--;
-        node->objects.erase(object);
+bool Octree::fitsInLeaf(const OctreeNode* node) const {
+    if (node->count <= capacity || node->halfSize <= minHalfSize)
+        return true;
+    std::array<int, 1 << 3> childCounts{};
+    if (isLeaf(node)) {
+        for (int id : node->objects) {
+            const unsigned int mask = registeredChildren(node, id);
+            for (int i = 0; i < 1 << 3; i++)
+                childCounts[i] += (mask >> i) & 1;
+        }
     }
     else {
-        node->count--;
-        if (node->isLeaf()) {
-            // have to pull up all objects in children
-            for (int i = 0; i < 1 << 3; i++) {
-                if (node->children[i] == nullptr)
-                    continue;
-                merge(node->objects, clean(node->children[i]));
-                node->children[i] = nullptr;
-            }
-            node->objects.erase(object);
-            if (node->count != node->objects.size())
-                dump();
-            assert(node->count == node->CAPACITY);
-            assert(node->objects.size() == node->CAPACITY);
+        for (int i = 0; i < 1 << 3; i++) {
+            if (node->child(i) != nullptr)
+                childCounts[i] = node->child(i)->count;
         }
-        else{
-            for (int i = 0; i < 1 << 3; i++) {
-                if (node->children[i] == nullptr)
-                    continue;
-                if (remove(node->children[i], object))
-                    node->children[i] = nullptr;
+    }
+    return !parts(childCounts, node->count);
+}
+
+// the same nodes as inserting the objects one by one, but each list of objects is made once and to size
+void Octree::build(OctreeNode* node, std::vector<int>& ids) {
+    node->count = ids.size();
+    auto makeLeaf = [&]() {
+        std::sort(ids.begin(), ids.end(), byShape);
+        node->objects.assign(ids.begin(), ids.end());
+    };
+    if (node->count <= capacity || node->halfSize <= minHalfSize) {
+        makeLeaf();
+        return;
+    }
+    std::array<std::vector<int>, 1 << 3> registered;
+    std::array<int, 1 << 3> childCounts{};
+    for (int id : ids) {
+        const unsigned int mask = registeredChildren(node, id);
+        for (int i = 0; i < 1 << 3; i++) {
+            if (mask & (1 << i)) {
+                registered[i].push_back(id);
+                childCounts[i]++;
             }
         }
     }
+    if (!parts(childCounts, node->count)) {
+        makeLeaf();
+        return;
+    }
+    ids = std::vector<int>();
+    for (int i = 0; i < 1 << 3; i++) {
+        if (!registered[i].empty())
+            build(makeChild(node, i), registered[i]);
+    }
+}
+
+void Octree::setDeferring(bool isDeferring) {
+    this->isDeferring = isDeferring;
+    if (!isDeferring)
+        restructure(std::chrono::steady_clock::duration::max());
+}
+
+void Octree::defer(OctreeNode* node) {
+    if (node->isQueued)
+        return;
+    node->isQueued = true;
+    counters.deferrals++;
+    restructureQueue.push_back({ node->center, node->halfSize });
+}
+
+OctreeNode* Octree::find(const NodeKey& key) const {
+    OctreeNode* node = root;
+    while (node != nullptr && node->halfSize > key.halfSize) {
+        int i = 0;
+        for (int pos = 0; pos < 3; pos++) {
+            if (key.center[pos] < node->center[pos])
+                i |= 1 << pos;
+        }
+        node = node->child(i);
+    }
+    return node != nullptr && node->halfSize == key.halfSize ? node : nullptr;
+}
+
+bool Octree::restructure(std::chrono::steady_clock::duration budget) {
+    ScopedTimer timer(ProfilePhase::OCTREE_RESTRUCTURE);
+    const OctreeCounters before = counters;
+    const bool isPending = drainRestructures(std::chrono::steady_clock::now(), budget);
+    timer.arg("splits", counters.splits - before.splits);
+    timer.arg("merges", counters.merges - before.merges);
+    timer.arg("pending", restructureQueue.size());
+    return isPending;
+}
+
+bool Octree::drainRestructures(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration budget) {
+    while (!restructureQueue.empty()) {
+        OctreeNode* node = find(restructureQueue.front());
+        restructureQueue.pop_front();
+        // released since, or found by an older key of its place
+        if (node == nullptr || !node->isQueued)
+            continue;
+        node->isQueued = false;
+        // the objects in it may have changed since, so that it needs neither
+        if (isLeaf(node) && !fitsInLeaf(node))
+            split(node);
+        else if (!isLeaf(node) && fitsInLeaf(node))
+            collapse(node);
+        if (std::chrono::steady_clock::now() - start >= budget)
+            break;
+    }
+    return !restructureQueue.empty();
+}
+
+// releases the nodes under node, without collecting their objects as clean does
+// nodeList is left to the caller
+void Octree::release(OctreeNode* node) {
+    if (observer != nullptr)
+        observer->nodeRemoved(node);
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child != nullptr)
+            release(child);
+    }
+    delete[] node->children;
+    node->children = nullptr;
+    node->childMask = 0;
+}
+
+// if true, the node had been cleaned and has to be released by its parent
+// assumption: object had been added to node
+bool Octree::remove(OctreeNode* node, int id) {
+    counters.nodesVisited++;
+    node->isContentDirty = true;
+    node->count--;
+
+    if (isLeaf(node)) {
+        assert(node->count + 1 == (int)node->objects.size());
+        erase(node->objects, id);
+        // the objects left may be parted by a split, e.g. without the one that spanned them
+        if (!node->isEmpty() && !node->isQueued && !fitsInLeaf(node)) {
+            if (isDeferring)
+                defer(node);
+            else
+                split(node);
+        }
+    }
+    else {
+        const unsigned int mask = registeredChildren(node, id);
+        for (int i = 0; i < 1 << 3; i++) {
+            auto child = node->child(i);
+            if (child == nullptr || !(mask & (1 << i)))
+                continue;
+            if (remove(child, id))
+                releaseChild(node, i);
+        }
+        if (!node->isEmpty() && fitsInLeaf(node)) {
+            if (isDeferring)
+                defer(node);
+            else
+                collapse(node);
+        }
+    }
     if (node->isEmpty()) {
         clean(node);
         return true;
@@ -297,209 +570,477 @@ bool Octree::remove(OctreeNode* node, SolidBody* object) {
         return false;
 }
 
-void Octree::remove(SolidBody* object) {
-    dbgcnt = 0;
+void Octree::collapse(OctreeNode* node) {
+    counters.merges++;
+    // have to pull up all objects in children
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child == nullptr)
+            continue;
+        merge(node->objects, clean(child));
+        releaseChild(node, i);
+    }
+}
+
+void Octree::remove(Body* object) {
+    ScopedTimer timer(ProfilePhase::OCTREE_REMOVE);
+    counters.removes++;
     if (root == nullptr || !objects.count(object)) {
         std::cerr << "can't find the object to remove" << std::endl;
         return;
     }
-    if (remove(root, object))
+    if (remove(root, object->getID())) {
+        delete root;
         root = nullptr;
+    }
+    if (shadow != nullptr && shadow->remove(shadow->root, object->getID())) {
+        delete shadow->root;
+        shadow->root = nullptr;
+    }
 
     objects.erase(object);
-    isDirty = true;
 }
 
-bool Octree::update(SolidBody* object)
-{
-    if (!object->containedInBoundary(boundary))
-        return false;
-    if (intersects(object))
-        return false;
+void Octree::setRegisteredBounds(const Body* object) {
+    const int id = object->getID();
+    if (id >= (int)registeredBounds.size()) {
+        registeredBounds.resize(id + 1);
+        queryStamps.resize(id + 1, 0);
+        queryLanes.resize(id + 1, 0);
+    }
+    Box registered = object->bounds();
+    for (int i = 0; i < 3; i++) {
+        registered.mins[i] -= fatMargin;
+        registered.maxs[i] += fatMargin;
+    }
+    registeredBounds[id] = registered;
+    if (fatMargin > 0 && geometry.type[id] == SolidBodyType::CAPSULE) {
+        if (id >= (int)registeredCapsules.size())
+            registeredCapsules.resize(id + 1);
+        CapsuleShape capsule = geometry.shape<CapsuleShape>(id);
+        capsule.radius += fatMargin;
+        registeredCapsules[id] = capsule;
+    }
+}
 
-    object->revert();
-    remove(object);
-    object->revert();
-    bool res = insert(object, true);
-    assert(res);
-    return res;
+bool Octree::isRegisteredIn(int id, const Box& box) const {
+    // fat volumes only change on insertion, so removal finds the same leaves
+    if (fatMargin > 0) {
+        if (geometry.type[id] == SolidBodyType::CAPSULE)
+            return intersectss(registeredCapsules[id], box, -0.000'01f);
+        return intersectss(registeredBounds[id], box, -0.000'01f);
+    }
+    else
+        return geometry.intersects(id, box);
 }
 
-SolidBody* Octree::rayQuery(OctreeNode* node, const glm::vec3& near, const glm::vec3& far) {
-    if (node == nullptr)
-        return nullptr;
+bool Octree::staysRegistered(int id, const Box& bounds, const glm::vec3& reach, float margin) const {
+    const Box& registered = registeredBounds[id];
+    bool isInside = true;
+    for (int i = 0; i < 3; i++) {
+        isInside = isInside && registered.mins[i] <= bounds.mins[i] + std::min(reach[i], 0.0f) - margin
+            && bounds.maxs[i] + std::max(reach[i], 0.0f) + margin <= registered.maxs[i];
+    }
+    if (!isInside || geometry.type[id] != SolidBodyType::CAPSULE)
+        return isInside;
 
-    if (node->isLeaf()) {
-        std::vector<std::pair<float, SolidBody*>> parameters;
-        for (auto object : node->objects) {
-            float t1, t2;
-            if (object->intersects(near, far, t1, t2))
-                parameters.push_back({ t1, object });
-        }
-        if (parameters.empty())
-            return nullptr;
-        else {
-            float min = parameters[0].first;
-            SolidBody* sb = parameters[0].second;
-            for (auto& tsb : parameters) {
-                if (tsb.first < min) {
-                    min = tsb.first;
-                    sb = tsb.second;
-                }
-            }
-            return sb;
-        }
+    // the distance to the registered segment is convex, so the capsule swept by reach is within the registered one
+    // if the ends of its segment, before and after, are within the difference of the radii
+    const CapsuleShape& capsule = registeredCapsules[id];
+    const CapsuleShape moved = geometry.shape<CapsuleShape>(id);
+    const float room = capsule.radius - moved.radius - margin;
+    for (const glm::vec3& end : { moved.a, moved.b, moved.a + reach, moved.b + reach }) {
+        if (distance(end, capsule.a, capsule.b) > room)
+            return false;
     }
+    return true;
+}
 
-    // todo: improve here
-    // currently using a bit inefficient (by a constant factor between 2 and 4) but simpler logic:
-    // intersection test for all sub-boxes, sort by parameter
-    std::vector<std::pair<float, OctreeNode*>> childrenToExplore;
+// insertions and removals both go down by this, rather than by the boundaries of the children,
+// which can differ from the subboxes by rounding
+unsigned int Octree::registeredChildren(const OctreeNode* node, int id) const {
+    unsigned int mask = 0;
     for (int i = 0; i < 1 << 3; i++) {
-        float t1, t2;
-        if (SolidBody::intersects(node->subBoxes[i], near, far, t1, t2))
-            childrenToExplore.push_back({ t1, node->children[i] });
+        if (isRegisteredIn(id, node->subBox(i)))
+            mask |= 1 << i;
     }
-    std::sort(childrenToExplore.begin(), childrenToExplore.end());
-    for (auto& tn : childrenToExplore) {
-        auto res = rayQuery(tn.second, near, far);
-        if (res != nullptr)
-            return res;
+    // rounding can also leave an object registered in node in none of its subboxes,
+    // it still has to be in a leaf below for the counts to hold: take the subbox of its center
+    if (mask == 0) {
+        const std::array<float, 3> center = registeredBounds[id].getCenter();
+        int i = 0;
+        for (int pos = 0; pos < 3; pos++) {
+            if (center[pos] < node->center[pos])
+                i |= 1 << pos;
+        }
+        mask = 1 << i;
     }
-    return nullptr;
+    return mask;
 }
 
-SolidBody* Octree::rayQuery(const glm::vec3& near, const glm::vec3& far) {
-    return rayQuery(root, near, far);
-}
+bool Octree::update(Body* object, bool isSafe)
+{
+    ScopedTimer timer(ProfilePhase::OCTREE_UPDATE);
+    counters.updates++;
+    if (!object->hasMoved())
+        return true;
+    if (!isSafe && (!object->containedInBoundary(boundary) || intersects(object))) {
+        object->revert();
+        return false;
+    }
+    if (shadow != nullptr)
+        shadow->follow(object);
 
-std::unordered_set<SolidBody*> Octree::frustumQuery(OctreeNode* node, const glm::vec3& from, const std::array<glm::vec3, 4>& to, float near, float far) {
-    return std::unordered_set<SolidBody*>();
-}
+    // still within the bounds it is registered by, so every leaf it overlaps already has it
+    if (fatMargin > 0) {
+        if (staysRegistered(object->getID(), object->bounds(), glm::vec3(0.0f), 0.0f)) {
+            counters.updatesSkipped++;
+            object->commit();
+            return true;
+        }
+    }
 
-std::vector<SolidBody*> Octree::frustumQuery(glm::vec3 from, std::array<glm::vec3, 4> to, float near, float far) {
-    assert(false && "not supported yet");
+    // removed as committed, inserted as proposed
+    // by the nodes, as the update is timed and counted as a whole rather than as a removal and an insertion
+    const int id = object->getID();
+    const Pose proposed = geometry.pose(id);
+    object->revert();
+    if (remove(root, id)) {
+        delete root;
+        root = nullptr;
+    }
+    geometry.setPose(id, proposed);
     if (root == nullptr)
-        return {};
-    auto res = frustumQuery(root, from, to, near, far);
-    return std::vector<SolidBody*>(res.begin(), res.end());
+        makeRoot();
+    setRegisteredBounds(object);
+    insert(root, id);
+    object->commit();
+    return true;
 }
 
-void Octree::init(){
-	shader.init();
+const Box& Octree::content(OctreeNode* node) {
+    if (!node->isContentDirty)
+        return node->content;
+    node->isContentDirty = false;
+
+    constexpr float MAX = std::numeric_limits<float>::max();
+    Box& content = node->content;
+    content = Box(MAX, MAX, MAX, -MAX, -MAX, -MAX);
+    auto expand = [&](const Box& box) {
+        for (int i = 0; i < 3; i++) {
+            content.mins[i] = std::min(content.mins[i], box.mins[i]);
+            content.maxs[i] = std::max(content.maxs[i], box.maxs[i]);
+        }
+    };
+    if (isLeaf(node)) {
+        for (int id : node->objects)
+            expand(registeredBounds[id]);
+    }
+    else {
+        for (int i = 0; i < 1 << 3; i++) {
+            auto child = node->child(i);
+            if (child != nullptr)
+                expand(this->content(child));
+        }
+    }
+    const Box boundary = node->boundary();
+    for (int i = 0; i < 3; i++) {
+        content.mins[i] = std::max(content.mins[i], boundary.mins[i]);
+        content.maxs[i] = std::min(content.maxs[i], boundary.maxs[i]);
+    }
+    return content;
+}
 
-    generateBoundary();
+void Octree::newQuery() {
+    counters.queries++;
+    queryStamp++;
+    if (queryStamp == 0) {
+        // wrapped around: stale stamps could collide with new ones
+        std::fill(queryStamps.begin(), queryStamps.end(), 0);
+        queryStamp = 1;
+    }
+}
 
-    bind();
+// returns the lanes (rays of a packet) that have not tested the object in the current query yet, and marks them
+unsigned int Octree::untestedLanes(int id, unsigned int lanes) {
+    if (queryStamps[id] != queryStamp) {
+        queryStamps[id] = queryStamp;
+        queryLanes[id] = 0;
+    }
+    for (unsigned int tested = lanes & queryLanes[id]; tested != 0; tested &= tested - 1)
+        counters.duplicateTestsAvoided++;
+    lanes &= ~queryLanes[id];
+    queryLanes[id] |= lanes;
+    return lanes;
 }
 
-void Octree::generateBoundary() {
-    for (int mask = 0; mask < 1 << 3; mask++) {
-        std::array<float, 3> vertex;
-        for (int pos = 0; pos < 3; pos++) {
-            if (mask & (1 << pos))
-                vertex[pos] = boundary.mins[pos];
-            else
-                vertex[pos] = boundary.maxs[pos];
-        }
-        addVertex(vertex);
+// children are visited front to back and pruned once they are entered beyond the best hit so far,
+// since an object is registered in every leaf it intersects, the nearest one can be found in a later leaf
+void Octree::rayQuery(OctreeNode* node, const glm::vec3& from, const glm::vec3& to, RayHit& hit, int lane) {
+    counters.nodesVisited++;
+    if (isLeaf(node)) {
+        forEachShape(node->objects, [&](int id, const auto& shape) {
+            if (!untestedLanes(id, 1 << lane))
+                return;
+            counters.narrowTests++;
+            float t1, t2;
+            if (intersectss(shape, from, to, t1, t2) && t1 < hit.t) {
+                hit.t = t1;
+                hit.object = geometry.body[id];
+            }
+        });
+        return;
     }
 
-    for (int mask = 0; mask < 1 << 3; mask++) {
-        for (int pos = 0; pos < 3; pos++) {
-            if (mask & (1 << pos))
-                continue;
-            int mask2 = mask | (1 << pos);
-            indices.push_back(mask);
-            indices.push_back(mask2);
-        }
+    std::array<std::pair<float, OctreeNode*>, 1 << 3> childrenToExplore;
+    int numChildren = 0;
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child == nullptr)
+            continue;
+        float t1, t2;
+        if (intersectss(content(child), from, to, t1, t2) && t1 < hit.t)
+            childrenToExplore[numChildren++] = { t1, child };
     }
+    sortChildren(childrenToExplore.data(), numChildren);
+    for (int i = 0; i < numChildren; i++) {
+        if (childrenToExplore[i].first >= hit.t)
+            break;
+        rayQuery(childrenToExplore[i].second, from, to, hit, lane);
+    }
+}
 
-    newVIndex = 8 * 3;
+static void completeHit(RayHit& hit, const glm::vec3& from, const glm::vec3& to) {
+    if (hit.object == nullptr)
+        return;
+    hit.point = from + hit.t * (to - from);
+    hit.distance = hit.t * glm::length(to - from);
 }
 
-void Octree::draw(const glm::mat4& projMat, const glm::mat4& viewMat) {
-    if (isDirty) {
-        updateBuffer();
-        isDirty = false;
-    }
+RayHit Octree::rayQuery(const glm::vec3& from, const glm::vec3& to) {
+    ScopedTimer timer(ProfilePhase::OCTREE_RAY_QUERY);
+    RayHit hit;
+    if (root == nullptr)
+        return hit;
+    newQuery();
+    rayQuery(root, from, to, hit);
+    completeHit(hit, from, to);
+    return hit;
+}
 
-    glUseProgram(shader.programID);
+static bool compareT1(const RayInterval& a, const RayInterval& b) {
+    return a.t1 < b.t1;
+}
 
-    // model matrix is simply identity
-    glm::mat4 vpMat = projMat * viewMat;
-    glUniformMatrix4fv(shader.vpMatID, 1, GL_FALSE, &vpMat[0][0]);
-    glUniform3fv(shader.lineColorID, 1, &lineColor[0]);
+// out is kept as a max-heap on t1 holding the first k intervals found so far
+void Octree::rayQueryAll(OctreeNode* node, const glm::vec3& from, const glm::vec3& to, std::vector<RayInterval>& out, int k) {
+    auto tBound = [&]() {
+        return (int)out.size() < k ? std::numeric_limits<float>::max() : out.front().t1;
+    };
 
-    glBindVertexArray(vertexArrayID);
+    counters.nodesVisited++;
+    if (isLeaf(node)) {
+        forEachShape(node->objects, [&](int id, const auto& shape) {
+            if (!untestedLanes(id, 1))
+                return;
+            counters.narrowTests++;
+            float t1, t2;
+            if (!intersectss(shape, from, to, t1, t2) || t1 >= tBound())
+                return;
+            out.push_back({ geometry.body[id], t1, t2 });
+            std::push_heap(out.begin(), out.end(), compareT1);
+            if ((int)out.size() > k) {
+                std::pop_heap(out.begin(), out.end(), compareT1);
+                out.pop_back();
+            }
+        });
+        return;
+    }
 
-    glDrawElements(
-        GL_LINES,          // mode
-        indices.size(),    // count
-        GL_UNSIGNED_INT,   // type
-        (void*)0           // element array buffer offset
-    );
+    std::array<std::pair<float, OctreeNode*>, 1 << 3> childrenToExplore;
+    int numChildren = 0;
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child == nullptr)
+            continue;
+        float t1, t2;
+        if (intersectss(content(child), from, to, t1, t2) && t1 < tBound())
+            childrenToExplore[numChildren++] = { t1, child };
+    }
+    sortChildren(childrenToExplore.data(), numChildren);
+    for (int i = 0; i < numChildren; i++) {
+        if (childrenToExplore[i].first >= tBound())
+            break;
+        rayQueryAll(childrenToExplore[i].second, from, to, out, k);
+    }
+}
 
-    glUseProgram(0);
-    glBindVertexArray(0);
+void Octree::rayQueryAll(const glm::vec3& from, const glm::vec3& to, std::vector<RayInterval>& out, int k) {
+    out.clear();
+    if (root == nullptr || k <= 0)
+        return;
+    newQuery();
+    rayQueryAll(root, from, to, out, k);
+    std::sort_heap(out.begin(), out.end(), compareT1);
 }
 
-void Octree::updateBuffer(){
-    glBindVertexArray(vertexArrayID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_DYNAMIC_DRAW);
+struct RayPacket {
+    static constexpr int WIDTH = 4;
+    std::array<glm::vec3, WIDTH> from, to;
+    std::array<RayHit, WIDTH> hits;
+    // per axis, one lane per ray
+    __m128 origins[3], invDirections[3];
+    // per axis, the lanes whose rays don't move along it
+    __m128 isParallel[3];
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
-    glBindVertexArray(0);
+    RayPacket(const glm::vec3* from, const glm::vec3* to, int count);
+    // slab test of all rays against the box at once
+    // returns the lanes entering the box before their best hits so far, with the entry parameters
+    unsigned int intersects(const Box& box, __m128& tEntry) const;
+};
+
+RayPacket::RayPacket(const glm::vec3* from, const glm::vec3* to, int count) {
+    for (int r = 0; r < WIDTH; r++) {
+        // unused lanes repeat the first ray and are masked out
+        this->from[r] = from[r < count ? r : 0];
+        this->to[r] = to[r < count ? r : 0];
+    }
+    for (int i = 0; i < 3; i++) {
+        std::array<float, WIDTH> origin, target, invDirection;
+        for (int r = 0; r < WIDTH; r++) {
+            origin[r] = this->from[r][i];
+            target[r] = this->to[r][i];
+            invDirection[r] = 1.0f / (target[r] - origin[r]);
+        }
+        origins[i] = _mm_loadu_ps(origin.data());
+        invDirections[i] = _mm_loadu_ps(invDirection.data());
+        isParallel[i] = _mm_cmpeq_ps(origins[i], _mm_loadu_ps(target.data()));
+    }
 }
 
-void Octree::bind(){
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
+// a where mask is set, b elsewhere
+static __m128 blend(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
 
-    glGenBuffers(1, &vertexBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(
-        0,                  // attribute #
-        3,                  // size
-        GL_FLOAT,           // type
-        GL_FALSE,           // normalized?
-        0,                  // stride
-        (void*)0            // array buffer offset
-    );
+unsigned int RayPacket::intersects(const Box& box, __m128& tEntry) const {
+    const __m128 INF = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128 MINUS_INF = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    __m128 t1 = _mm_setzero_ps();
+    __m128 t2 = _mm_set1_ps(1.0f);
+    __m128 isOutside = _mm_setzero_ps();
+    for (int i = 0; i < 3; i++) {
+        __m128 mins = _mm_set1_ps(box.mins[i]), maxs = _mm_set1_ps(box.maxs[i]);
+        __m128 tMin = _mm_mul_ps(_mm_sub_ps(mins, origins[i]), invDirections[i]);
+        __m128 tMax = _mm_mul_ps(_mm_sub_ps(maxs, origins[i]), invDirections[i]);
+        // as in intersectss, a ray parallel to the slab is either in it for every t or never,
+        // and its infinite inverse would give NaN for an origin on a plane of the slab
+        __m128 enter = blend(isParallel[i], MINUS_INF, _mm_min_ps(tMin, tMax));
+        __m128 exit = blend(isParallel[i], INF, _mm_max_ps(tMin, tMax));
+        isOutside = _mm_or_ps(isOutside, _mm_and_ps(isParallel[i], _mm_or_ps(_mm_cmplt_ps(origins[i], mins), _mm_cmplt_ps(maxs, origins[i]))));
+        t1 = _mm_max_ps(t1, enter);
+        t2 = _mm_min_ps(t2, exit);
+    }
+    __m128 best = _mm_setr_ps(hits[0].t, hits[1].t, hits[2].t, hits[3].t);
+    tEntry = t1;
+    return _mm_movemask_ps(_mm_andnot_ps(isOutside, _mm_and_ps(_mm_cmple_ps(t1, t2), _mm_cmplt_ps(t1, best))));
+}
 
-    glGenBuffers(1, &elementBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
+void Octree::rayQuery(OctreeNode* node, RayPacket& packet, unsigned int lanes) {
+    counters.nodesVisited++;
+    if (isLeaf(node)) {
+        forEachShape(node->objects, [&](int id, const auto& shape) {
+            unsigned int todo = untestedLanes(id, lanes);
+            for (int r = 0; r < RayPacket::WIDTH; r++) {
+                if (!(todo & (1 << r)))
+                    continue;
+                counters.narrowTests++;
+                float t1, t2;
+                if (intersectss(shape, packet.from[r], packet.to[r], t1, t2) && t1 < packet.hits[r].t) {
+                    packet.hits[r].t = t1;
+                    packet.hits[r].object = geometry.body[id];
+                }
+            }
+        });
+        return;
+    }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glDisableVertexAttribArray(0);
+    // ordered by the nearest entry among the rays of the packet
+    std::array<std::pair<float, int>, 1 << 3> childrenToExplore;
+    int numChildren = 0;
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child == nullptr)
+            continue;
+        __m128 tEntry;
+        unsigned int hitLanes = packet.intersects(content(child), tEntry) & lanes;
+        if (hitLanes == 0)
+            continue;
+        std::array<float, RayPacket::WIDTH> t;
+        _mm_storeu_ps(t.data(), tEntry);
+        float tMin = std::numeric_limits<float>::max();
+        for (int r = 0; r < RayPacket::WIDTH; r++) {
+            if (hitLanes & (1 << r))
+                tMin = std::min(tMin, t[r]);
+        }
+        childrenToExplore[numChildren++] = { tMin, i };
+    }
+    sortChildren(childrenToExplore.data(), numChildren);
+    for (int i = 0; i < numChildren; i++) {
+        auto child = node->child(childrenToExplore[i].second);
+        // the best hits may have improved since the children were sorted
+        __m128 tEntry;
+        unsigned int hitLanes = packet.intersects(content(child), tEntry) & lanes;
+        if (hitLanes == 0)
+            continue;
+        // the rays have diverged: continue with the single remaining one
+        if ((hitLanes & (hitLanes - 1)) == 0) {
+            int r = 0;
+            while (!(hitLanes & (1 << r)))
+                r++;
+            rayQuery(child, packet.from[r], packet.to[r], packet.hits[r], r);
+        }
+        else
+            rayQuery(child, packet, hitLanes);
+    }
 }
 
-Octree::~Octree() {
-    if (vertexArrayID != 0)
-        glDeleteVertexArrays(1, &vertexArrayID);
-    if (vertexBufferID != 0)
-        glDeleteBuffers(1, &vertexBufferID);
-    if (elementBufferID != 0)
-        glDeleteBuffers(1, &elementBufferID);
+std::vector<RayHit> Octree::rayQueryBatch(const std::vector<glm::vec3>& from, const std::vector<glm::vec3>& to) {
+    assert(from.size() == to.size());
+    std::vector<RayHit> hits(from.size());
+    if (root == nullptr)
+        return hits;
+
+    for (int first = 0; first < (int)from.size(); first += RayPacket::WIDTH) {
+        int count = std::min<int>(RayPacket::WIDTH, (int)from.size() - first);
+        RayPacket packet(&from[first], &to[first], count);
+        newQuery();
+        rayQuery(root, packet, (1 << count) - 1);
+        for (int r = 0; r < count; r++) {
+            hits[first + r] = packet.hits[r];
+            completeHit(hits[first + r], from[first + r], to[first + r]);
+        }
+    }
+    return hits;
 }
 
-void Octree::addVertex(const std::array<float, 3>& vertex) {
-    for (int i = 0; i < 3; i++)
-        vertices.push_back(vertex[i]);
+std::unordered_set<Body*> Octree::frustumQuery(OctreeNode* node, const glm::vec3& from, const std::array<glm::vec3, 4>& to, float near, float far) {
+    return std::unordered_set<Body*>();
 }
-void Octree::insertVertex(int index, const std::array<float, 3>& vertex) {
-    for (int i = 0; i < 3; i++)
-        vertices[index+i] = vertex[i];
+
+std::vector<Body*> Octree::frustumQuery(glm::vec3 from, std::array<glm::vec3, 4> to, float near, float far) {
+    assert(false && "not supported yet");
+    if (root == nullptr)
+        return {};
+    auto res = frustumQuery(root, from, to, near, far);
+    return std::vector<Body*>(res.begin(), res.end());
 }
-void Octree::addIndex(int index) {
-    indices.push_back(index);
+
+void Octree::setObserver(OctreeObserver* observer) {
+    this->observer = observer;
+    if (observer != nullptr)
+        for (auto node : nodeList)
+            observer->nodeAdded(node);
 }
 
 void Octree::dump(OctreeNode* node) {
@@ -510,19 +1051,235 @@ void Octree::dump(OctreeNode* node) {
     for (auto obj : node->objects)
         std::cout << obj << ' ';
     std::cout << std::endl;
-    for (auto child : node->children)
-        std::cout << child << ' ';
+    for (int i = 0; i < 1 << 3; i++)
+        std::cout << node->child(i) << ' ';
     std::cout << std::endl;
     std::cout << std::endl;
 
-    for (auto child : node->children)
-        dump(child);
+    for (int i = 0; i < 1 << 3; i++)
+        dump(node->child(i));
 }
 
 void Octree::dump() {
     std::cout << std::endl;
     std::cout << "============= dump start ============" << std::endl;
     dump(root);
+    std::cout << "duplicate tests avoided: " << counters.duplicateTestsAvoided << std::endl;
+    std::cout << "updates skipped: " << counters.updatesSkipped << std::endl;
+    if (!nodeList.empty())
+        std::cout << "bytes per node: " << nodeMemoryUsage() / nodeList.size() << std::endl;
     std::cout << "============= dump end ==============" << std::endl;
     std::cout << std::endl;
-}
\ No newline at end of file
+}
+
+size_t Octree::nodeMemoryUsage() const {
+    size_t bytes = 0;
+    for (auto node : nodeList) {
+        bytes += sizeof(OctreeNode) + node->objects.capacity() * sizeof(int);
+        // blocks of children hold unused slots as well
+        if (node->children != nullptr) {
+            for (int i = 0; i < 1 << 3; i++) {
+                if (node->child(i) == nullptr)
+                    bytes += sizeof(OctreeNode);
+            }
+        }
+    }
+    return bytes;
+}
+
+size_t Octree::registrations() const {
+    size_t count = 0;
+    for (auto node : nodeList)
+        if (isLeaf(node))
+            count += node->objects.size();
+    return count;
+}
+void Octree::collectStats(const OctreeNode* node, int depth, OctreeStats& stats) const {
+    stats.nodes++;
+    if (isLeaf(node)) {
+        stats.leaves++;
+        if ((int)stats.leavesByDepth.size() <= depth)
+            stats.leavesByDepth.resize(depth + 1);
+        stats.leavesByDepth[depth]++;
+        stats.leavesByOccupancy[std::min<size_t>(node->objects.size(), capacity + 1)]++;
+        stats.registrations += node->objects.size();
+        return;
+    }
+    for (int i = 0; i < 1 << 3; i++) {
+        auto child = node->child(i);
+        if (child != nullptr)
+            collectStats(child, depth + 1, stats);
+    }
+}
+
+void Octree::publishStats(bool resetsCounters) {
+    OctreeStats stats;
+    stats.leavesByOccupancy.resize(capacity + 2);
+    if (root != nullptr)
+        collectStats(root, 0, stats);
+    stats.objects = objects.size();
+    stats.bytes = nodeMemoryUsage();
+    stats.pendingRestructures = restructureQueue.size();
+    stats.counters = counters;
+    if (resetsCounters)
+        resetCounters();
+
+    if (rebuildPolicy.isEnabled) {
+        statsSinceRebuild++;
+        if (!hasReference) {
+            // the nodes visited per query need queries
+            if (stats.counters.queries > 0) {
+                reference = stats;
+                hasReference = true;
+            }
+        }
+        else if (statsSinceRebuild > rebuildPolicy.cooldown && shadow == nullptr)
+            needsRebuild = isPastPolicy(stats);
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    publishedStats = std::move(stats);
+}
+
+OctreeStats Octree::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return publishedStats;
+}
+
+void Octree::setRebuildPolicy(const OctreeRebuildPolicy& policy) {
+    rebuildPolicy = policy;
+    hasReference = false;
+    statsSinceRebuild = 0;
+    needsRebuild = false;
+}
+
+bool Octree::isPastPolicy(const OctreeStats& stats) const {
+    const OctreeRebuildPolicy& policy = rebuildPolicy;
+    return stats.duplication() > reference.duplication() * policy.duplication
+        || stats.occupancy() < reference.occupancy() * policy.occupancy
+        || (stats.counters.queries > 0 && stats.nodesPerQuery() > reference.nodesPerQuery() * policy.nodesPerQuery)
+        || stats.bytesPerRegistration() > reference.bytesPerRegistration() * policy.bytesPerRegistration
+        || stats.depth() > reference.depth() + policy.depth;
+}
+
+bool Octree::maintain(std::chrono::steady_clock::duration budget) {
+    const auto start = std::chrono::steady_clock::now();
+    if (shadow == nullptr) {
+        if (!needsRebuild)
+            return false;
+        if (budget == std::chrono::steady_clock::duration::max()) {
+            rebuild();
+            return true;
+        }
+        needsRebuild = false;
+        shadow = std::make_unique<Octree>(boundary.maxs[0], fatMargin, capacity);
+        // the same room per object id, so that the vectors can be swapped
+        shadow->registeredBounds.resize(registeredBounds.size());
+        shadow->registeredCapsules.resize(registeredCapsules.size());
+        shadow->queryStamps.resize(queryStamps.size(), 0);
+        shadow->queryLanes.resize(queryLanes.size(), 0);
+        if (!objects.empty()) {
+            std::vector<int> ids;
+            ids.reserve(objects.size());
+            for (Body* object : objects) {
+                shadow->setRegisteredBounds(object);
+                ids.push_back(object->getID());
+            }
+            std::sort(ids.begin(), ids.end(), byShape);
+            shadow->makeRoot();
+            shadow->root->count = ids.size();
+            shadow->root->objects = std::move(ids);
+            // split or not once dequeued
+            shadow->defer(shadow->root);
+        }
+    }
+
+    ScopedTimer timer(ProfilePhase::OCTREE_REBUILD);
+    // the children of its splits are queued in turn, while its restructures follow the ones of this octree otherwise
+    shadow->isDeferring = true;
+    const bool isPending = shadow->drainRestructures(start, budget);
+    shadow->isDeferring = isDeferring;
+    timer.arg("pending", shadow->restructureQueue.size());
+    if (isPending)
+        return false;
+
+    // the old nodes are gone before the first new one is told, as by rebuild
+    if (root != nullptr) {
+        release(root);
+        delete root;
+    }
+    root = shadow->root;
+    shadow->root = nullptr;
+    nodeList = std::move(shadow->nodeList);
+    if (observer != nullptr) {
+        for (auto node : nodeList)
+            observer->nodeAdded(node);
+    }
+    registeredBounds.swap(shadow->registeredBounds);
+    registeredCapsules.swap(shadow->registeredCapsules);
+    restructureQueue.clear();
+    shadow.reset();
+
+    counters.rebuilds++;
+    hasReference = false;
+    statsSinceRebuild = 0;
+    return true;
+}
+
+void Octree::follow(Body* object) {
+    const int id = object->getID();
+    if (fatMargin > 0 && staysRegistered(id, object->bounds(), glm::vec3(0.0f), 0.0f))
+        return;
+    // as update does, removed as committed and inserted as proposed
+    const Pose proposed = geometry.pose(id);
+    object->revert();
+    if (remove(root, id)) {
+        delete root;
+        root = nullptr;
+    }
+    geometry.setPose(id, proposed);
+    if (root == nullptr)
+        makeRoot();
+    setRegisteredBounds(object);
+    insert(root, id);
+}
+
+void Octree::dropShadow() {
+    if (shadow == nullptr)
+        return;
+    if (shadow->root != nullptr) {
+        shadow->release(shadow->root);
+        delete shadow->root;
+    }
+    shadow.reset();
+}
+
+void Octree::rebuild() {
+    ScopedTimer timer(ProfilePhase::OCTREE_REBUILD);
+    counters.rebuilds++;
+    needsRebuild = false;
+    hasReference = false;
+    statsSinceRebuild = 0;
+    dropShadow();
+
+    // the old nodes are gone before the first new one is made, e.g. for the observer
+    if (root != nullptr) {
+        release(root);
+        delete root;
+        root = nullptr;
+    }
+    nodeList = std::vector<OctreeNode*>();
+    restructureQueue.clear();
+    if (objects.empty())
+        return;
+
+    // the fat bounds are centered on the objects again
+    std::vector<int> ids;
+    ids.reserve(objects.size());
+    for (Body* object : objects) {
+        setRegisteredBounds(object);
+        ids.push_back(object->getID());
+    }
+    makeRoot();
+    build(root, ids);
+}
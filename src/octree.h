@@ -1,81 +1,311 @@
 #pragma once
-#include <gl/glew.h>
 #include <glm/glm.hpp>
 
-#include "shader.h"
-#include "object.h"
+#include "body.h"
+#include "narrow_phase.h"
 
 #include <array>
+#include <chrono>
+#include <deque>
 #include <vector>
 #include <unordered_set>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <mutex>
 
 class OctreeNode {
 public:
-	static constexpr int CAPACITY = 10;
+	static constexpr int CAPACITY = 10; // by default
+	// the registered volumes of oriented cubes (and fat ones) may overlap, so more than the capacity can share a point:
+	// a node this deep, or no larger than the fat margin, is never split, nor is one whose split would not part its objects
+	static constexpr int MAX_DEPTH = 10;
 private:
-	std::unordered_set<SolidBody*> objects;
+	std::vector<int> objects; // ids in the geometry store
+	// the 8 children are allocated together on the first split, childMask tells which of them are in use
+	OctreeNode* children{ nullptr };
+	std::array<float, 3> center{};
+	float halfSize{ 0.0f };
 	int count{0};
-	const std::array<float, 3> center;
-	Box boundary;
-	const std::array<Box, 1<<3> subBoxes;
-	std::array<OctreeNode*, 1<<3> children;
 	int nodeID; // just the position in nodeList
-	int vIndex;
+	// tight bounds of the objects inside, clipped to boundary
+	// recomputed lazily once an insertion or a removal passes through the node
+	Box content{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	unsigned char childMask{ 0 };
+	bool isContentDirty{ true };
+	bool isQueued{ false }; // to be split or merged
 
 	const bool isEmpty() const { return count == 0; }
-	const bool isLeaf() const { return count <= CAPACITY; }
-	std::array<Box, 1 << 3> makeSubBoxes(const std::array<float, 3>& center, const Box& boundary);
-public:
-	OctreeNode(const std::array<float, 3>& center, const Box& boundary, int nodeID, int vIndex, std::vector<OctreeNode*>& nodeList);
+	OctreeNode* child(int i) const { return childMask & (1 << i) ? &children[i] : nullptr; }
+	Box subBox(int i) const;
 
 	friend class Octree;
+public:
+	Box boundary() const;
+};
+
+// notified when nodes are made or released, e.g. to draw the structure of an octree
+class OctreeObserver {
+public:
+	virtual ~OctreeObserver() {}
+	virtual void nodeAdded(const OctreeNode* node) = 0;
+	// before the node is released
+	virtual void nodeRemoved(const OctreeNode* node) = 0;
+};
+
+struct RayHit {
+	Body* object{ nullptr };
+	// the hit point is from + t * (to-from)
+	float t{ std::numeric_limits<float>::max() };
+	float distance{ 0.0f };
+	glm::vec3 point{ 0.0f };
+};
+
+struct RayInterval {
+	Body* object;
+	// the object occupies from + [t1..t2] * (to-from)
+	float t1, t2;
+};
+
+struct SweepHit {
+	// nullptr if nothing is hit or the boundary of the octree is hit first
+	Body* object{ nullptr };
+	// the object can move up to t * displacement
+	float t{ 1.0f };
+};
+
+struct RayPacket;
+
+// work done by the operations of an octree, e.g. for benchmarks
+struct OctreeCounters {
+	long long inserts{ 0 };
+	long long removes{ 0 };
+	long long updates{ 0 };
+	// of the updates, those within the fat bounds of the object
+	long long updatesSkipped{ 0 };
+	// collision tests, sweeps and rays, including the collision tests of insertions and updates
+	long long queries{ 0 };
+	long long nodesVisited{ 0 };
+	// exact tests of an object against another object or a ray
+	long long narrowTests{ 0 };
+	// of objects registered in several leaves of a query
+	long long duplicateTestsAvoided{ 0 };
+	// leaves turned into internal nodes and back
+	long long splits{ 0 };
+	long long merges{ 0 };
+	// of the leaves to split and the nodes to merge, those queued for restructure
+	long long deferrals{ 0 };
+	long long rebuilds{ 0 };
+};
+
+// the structure of an octree, with the work done since the counters were reset
+struct OctreeStats {
+	int nodes{ 0 };
+	int leaves{ 0 };
+	std::vector<int> leavesByDepth; // the root is at depth 0
+	// leavesByOccupancy[i] leaves hold i objects, the last entry counts the leaves over the capacity
+	// (of the smallest nodes, or waiting to be split)
+	std::vector<int> leavesByOccupancy;
+	size_t objects{ 0 };
+	// (object, leaf) pairs, an object is registered in every leaf it intersects
+	size_t registrations{ 0 };
+	double duplication() const { return objects == 0 ? 0.0 : double(registrations) / objects; }
+	size_t bytes{ 0 }; // held by the nodes
+	// nodes queued to be split or merged, some may be gone already
+	size_t pendingRestructures{ 0 };
+	OctreeCounters counters;
+
+	// the quality of the octree
+	int depth() const { return std::max((int)leavesByDepth.size() - 1, 0); }
+	// objects per leaf
+	double occupancy() const { return leaves == 0 ? 0.0 : double(registrations) / leaves; }
+	// nodes visited by every operation, per query
+	double nodesPerQuery() const { return counters.queries == 0 ? 0.0 : double(counters.nodesVisited) / counters.queries; }
+	double bytesPerRegistration() const { return registrations == 0 ? 0.0 : double(bytes) / registrations; }
+	double bytesPerNode() const { return nodes == 0 ? 0.0 : double(bytes) / nodes; }
+};
+
+// how much worse than right after its last rebuild (or its first statistics) an octree may get
+// before it is due for another rebuild, e.g. as the fat bounds drift away from the objects and the nodes hold memory they no longer use
+// a rebuild that does not help becomes the new reference, so it is not repeated
+struct OctreeRebuildPolicy {
+	bool isEnabled{ false };
+	// ratios to the reference, of the quality measures of OctreeStats
+	float duplication{ 1.1f };
+	float occupancy{ 0.8f }; // a lower bound
+	float nodesPerQuery{ 1.5f };
+	float bytesPerRegistration{ 1.15f };
+	int depth{ 2 }; // more levels than the reference
+	// statistics (i.e. frames) to wait after a rebuild
+	int cooldown{ 60 };
 };
 
 class Octree {
 public:
-	Octree(float max) : boundary(-max, -max, -max, max, max, max), root(nullptr) {}
-	~Octree();
-	void init();
-
-	void draw(const glm::mat4& projMat, const glm::mat4& viewMat);
-	bool insert(SolidBody* object, bool isSafe = false);
-	bool update(SolidBody* object); // assumes object is in the octree
-	void remove(SolidBody* object); // assumes object is in the octree
-	bool intersects(SolidBody* object);
-	SolidBody* rayQuery(const glm::vec3&, const glm::vec3&);
-	std::vector<SolidBody*> frustumQuery(glm::vec3 from, std::array<glm::vec3, 4> to, float near, float far);
+	// with a fat margin, objects are registered by their bounds grown by it,
+	// and update only restructures once an object leaves those
+	// a leaf holding more objects than the capacity is split
+	Octree(float max, float fatMargin = 0.0f, int capacity = OctreeNode::CAPACITY)
+		: boundary(-max, -max, -max, max, max, max), root(nullptr), fatMargin(fatMargin), capacity(capacity),
+		minHalfSize(std::max(max / (1 << OctreeNode::MAX_DEPTH), fatMargin)) {}
+
+	// told about every node there is at once, then about the changes, until replaced (or set to nullptr)
+	void setObserver(OctreeObserver* observer);
+	const Box& getBoundary() const { return boundary; }
+	// both commit the proposed pose of the object on success, update reverts it otherwise
+	bool insert(Body* object, bool isSafe = false);
+	// assumes object is in the octree
+	// isSafe: the proposed pose is known to be inside the boundary and clear of the other objects, e.g. by a sweep
+	bool update(Body* object, bool isSafe = false);
+	void remove(Body* object); // assumes object is in the octree
+	bool intersects(Body* object);
+	// time of impact of the object translated by displacement, against the other objects and the boundary
+	SweepHit sweep(Body* object, const glm::vec3& displacement);
+	// translates the object up to the first hit of its sweep and updates it
+	// t of the hit is 0 if the update fails and the object stays
+	SweepHit move(Body* object, const glm::vec3& displacement);
+	RayHit rayQuery(const glm::vec3& from, const glm::vec3& to);
+	// same as rayQuery for each from[i] -> to[i], but traverses the octree with packets of rays
+	// nearby rays should be adjacent for the packets to stay coherent, e.g. in tiles of a camera grid:
+	// scattered rays split the packets at once and are faster one by one
+	std::vector<RayHit> rayQueryBatch(const std::vector<glm::vec3>& from, const std::vector<glm::vec3>& to);
+	// all objects along the segment, or only the first k of them, sorted by t1
+	void rayQueryAll(const glm::vec3& from, const glm::vec3& to, std::vector<RayInterval>& out, int k = std::numeric_limits<int>::max());
+	std::vector<Body*> frustumQuery(glm::vec3 from, std::array<glm::vec3, 4> to, float near, float far);
 
 	void dump();
+	// bytes held by the nodes, including their object lists
+	size_t nodeMemoryUsage() const;
+	// (object, leaf) pairs, an object is registered in every leaf it intersects
+	size_t registrations() const;
+	int getCapacity() const { return capacity; }
+	float getFatMargin() const { return fatMargin; }
+	// accumulated since the octree was made or the last reset
+	const OctreeCounters& getCounters() const { return counters; }
+	void resetCounters() { counters = OctreeCounters(); }
+	// by the thread using the octree, e.g. once per frame: takes the statistics for stats, and resets the counters if asked
+	// walks every node
+	void publishStats(bool resetsCounters = true);
+	// as of the last publishStats, from any thread
+	OctreeStats stats() const;
+	// publishStats tells whether a rebuild is due by the policy
+	void setRebuildPolicy(const OctreeRebuildPolicy& policy);
+	const OctreeRebuildPolicy& getRebuildPolicy() const { return rebuildPolicy; }
+	bool isRebuildDue() const { return needsRebuild; }
+	// rebuilds the octree if it is due, true once it did
+	// with a budget, a slice per call: a new octree is built beside this one, a split at a time until the budget is spent
+	// (after one at least, so the first call registers every object in its root and splits it), and swapped in once done
+	// it follows the insertions, moves and removals meanwhile, which cost about twice as much, and this one is left as it is
+	// without one, it rebuilds at once
+	// by the thread using the octree, between frames: the objects have to be at their committed poses
+	bool maintain(std::chrono::steady_clock::duration budget = std::chrono::steady_clock::duration::max());
+	bool isRebuilding() const { return shadow != nullptr; }
+	// while deferring, insertions and removals only queue the leaves to split and the nodes to merge, for restructure:
+	// leaves can hold more objects than the capacity meanwhile, and internal nodes no more objects than it
+	// turning it off restructures everything queued
+	void setDeferring(bool isDeferring);
+	bool isDeferringRestructures() const { return isDeferring; }
+	// splits and merges the queued nodes, oldest first, until the budget is spent (after one of them at least)
+	// by the thread using the octree, e.g. once per frame; true if some are left
+	bool restructure(std::chrono::steady_clock::duration budget);
+	size_t pendingRestructures() const { return restructureQueue.size(); }
+	// registers every object anew by its current bounds, into nodes allocated and filled at once
+	// the result is the octree that inserting the objects one by one would make, without the memory the old nodes kept
+	void rebuild();
 private:
 	const Box boundary;
 	OctreeNode* root;
-	std::unordered_set<SolidBody*> objects;
-
-	const glm::vec3 lineColor{ 0.7f, 0.7f, 0.7f };
-	std::vector<GLfloat> vertices;
-	std::vector<unsigned int> indices;
-	GLuint vertexArrayID, vertexBufferID, elementBufferID;
-	LineShader shader;
-	void bind();
-	void generateBoundary();
-
-	void insertVertex(int index, const std::array<float, 3>& vertex);
-	void addVertex(const std::array<float, 3>& vertex);
-	void addIndex(int index);
-
-	bool isDirty{ false };
-	void updateBuffer();
-
-	int newVIndex{0};
-	std::vector<int> deletedVIndex;
-	std::vector<OctreeNode*> nodeList; // index buffer is configured in the order in node list
-	OctreeNode* makeNode(const std::array<float, 3>& center, const Box& boundary);
-	void insert(OctreeNode* node, SolidBody* object);
-	bool remove(OctreeNode* node, SolidBody* object);
-	std::unordered_set<SolidBody*> clean(OctreeNode* node);
-	bool intersects(OctreeNode* node, SolidBody* object);
-	SolidBody* rayQuery(OctreeNode* node, const glm::vec3&, const glm::vec3&);
-	std::unordered_set<SolidBody*> frustumQuery(OctreeNode* node, const glm::vec3& from, const std::array<glm::vec3, 4>& to, float near, float far);
+	std::unordered_set<Body*> objects;
+
+	const float fatMargin;
+	const int capacity;
+	const float minHalfSize; // of a node that is never split
+	bool isLeaf(const OctreeNode* node) const { return node->childMask == 0; }
+	// whether the node should be a leaf, i.e. a leaf that does not is split and an internal node that does is merged
+	// by the objects registered in the node only, so that the octree does not depend on the order of the operations
+	bool fitsInLeaf(const OctreeNode* node) const;
+	// whether a split would part the objects of the node, registered in the children as counted:
+	// not if one of the children would hold them all while some of them are in several children,
+	// e.g. objects overlapping or a hair apart, which no depth parts
+	static bool parts(const std::array<int, 1 << 3>& childCounts, int count);
+	OctreeCounters counters;
+	mutable std::mutex statsMutex;
+	OctreeStats publishedStats;
+	void collectStats(const OctreeNode* node, int depth, OctreeStats& stats) const;
+	OctreeRebuildPolicy rebuildPolicy;
+	// the quality to compare with, taken by the first publishStats after a rebuild that saw a query
+	OctreeStats reference;
+	bool hasReference{ false };
+	int statsSinceRebuild{ 0 };
+	bool needsRebuild{ false };
+	bool isPastPolicy(const OctreeStats& stats) const;
+	// of a rebuild by slices, the octree built beside this one: its root starts with every object, registered by its bounds then,
+	// as a leaf queued to split, and it is done once its queue is drained
+	std::unique_ptr<Octree> shadow;
+	// of a shadow, the object proposed to move is registered anew, unless it stays within the volume it is registered by
+	void follow(Body* object);
+	// releases the nodes of the shadow, which has no observer to tell
+	void dropShadow();
+	// per object id, kept by the octree rather than in the geometry store, as other octrees may hold the same objects
+	// the bounds the object is registered by, as of its last insertion, grown by the fat margin
+	std::vector<Box> registeredBounds;
+	// with a fat margin, a capsule is registered by its shape as of its last insertion, grown by the margin, rather than by its bounds
+	// so that a long diagonal one is not in every leaf of its fat box, indexed by object id and grown only for capsules
+	std::vector<CapsuleShape> registeredCapsules;
+	// sets them, and makes room for the id in the vectors kept per object id
+	void setRegisteredBounds(const Body* object);
+	// whether the object is registered in a node with the given boundary
+	bool isRegisteredIn(int id, const Box& box) const;
+	// whether the object, with the given bounds and moved by reach, stays within the volume it is registered by, by margin
+	bool staysRegistered(int id, const Box& bounds, const glm::vec3& reach, float margin) const;
+	// the children of node the object is registered in, as a mask
+	unsigned int registeredChildren(const OctreeNode* node, int id) const;
+
+	// every query stamps the objects it tests, so that an object registered in several leaves is tested once
+	// for ray packets, the rays (lanes) that tested the object are kept in queryLanes
+	unsigned int queryStamp{ 0 };
+	std::vector<unsigned int> queryStamps, queryLanes; // per object id
+	void newQuery();
+	unsigned int untestedLanes(int id, unsigned int lanes);
+	// reused by leaf scans
+	CandidateBatch batch;
+
+	OctreeObserver* observer{ nullptr };
+	std::vector<OctreeNode*> nodeList;
+	void makeNode(OctreeNode* node, const std::array<float, 3>& center, float halfSize);
+	void makeRoot();
+	OctreeNode* makeChild(OctreeNode* node, int i);
+	void releaseChild(OctreeNode* node, int i);
+	void insert(OctreeNode* node, int id);
+	bool remove(OctreeNode* node, int id);
+	std::vector<int> clean(OctreeNode* node);
+	unsigned int pushDown(OctreeNode* node, int id);
+	void split(OctreeNode* node);
+	void collapse(OctreeNode* node); // merges the children into node
+	// the queued nodes are looked up again by where they are, as they may have been released since
+	struct NodeKey {
+		std::array<float, 3> center;
+		float halfSize;
+	};
+	bool isDeferring{ false };
+	std::deque<NodeKey> restructureQueue;
+	void defer(OctreeNode* node);
+	OctreeNode* find(const NodeKey& key) const;
+	// restructure without its timer, also for a shadow; true if some are left
+	bool drainRestructures(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration budget);
+	// the objects registered in node are given, node is a leaf if their number allows
+	void build(OctreeNode* node, std::vector<int>& ids);
+	void release(OctreeNode* node);
+	bool intersects(OctreeNode* node, int id);
+	void sweep(OctreeNode* node, int id, const glm::vec3& displacement, SweepHit& hit);
+	void sweepLeaf(OctreeNode* node, int id, const glm::vec3& displacement, SweepHit& hit);
+	void sweepRegistered(OctreeNode* node, int id, const glm::vec3& displacement, SweepHit& hit);
+	void rayQuery(OctreeNode* node, const glm::vec3& from, const glm::vec3& to, RayHit& hit, int lane = 0);
+	void rayQuery(OctreeNode* node, RayPacket& packet, unsigned int lanes);
+	void rayQueryAll(OctreeNode* node, const glm::vec3& from, const glm::vec3& to, std::vector<RayInterval>& out, int k);
+	std::unordered_set<Body*> frustumQuery(OctreeNode* node, const glm::vec3& from, const std::array<glm::vec3, 4>& to, float near, float far);
+
+	const Box& content(OctreeNode* node);
 
 	void dump(OctreeNode* node);
 };
\ No newline at end of file
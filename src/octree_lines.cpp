@@ -0,0 +1,258 @@
+#include "octree_lines.h"
+
+#include <cassert>
+
+OctreeLines::~OctreeLines() {
+    detach();
+    if (vertexArrayID != 0)
+        glDeleteVertexArrays(1, &vertexArrayID);
+    if (vertexBufferID != 0)
+        glDeleteBuffers(1, &vertexBufferID);
+    if (elementBufferID != 0)
+        glDeleteBuffers(1, &elementBufferID);
+}
+
+void OctreeLines::init() {
+    shader.init();
+
+    bind();
+}
+
+void OctreeLines::attach(Octree& octree) {
+    detach();
+    this->octree = &octree;
+    generateBoundary(octree.getBoundary());
+    octree.setObserver(this);
+}
+
+void OctreeLines::detach() {
+    if (octree == nullptr)
+        return;
+    octree->setObserver(nullptr);
+    octree = nullptr;
+    vertices.clear();
+    indices.clear();
+    newVIndex = 0;
+    deletedVIndex.clear();
+    nodes.clear();
+    position.clear();
+    isDirty = true;
+}
+
+void OctreeLines::generateBoundary(const Box& boundary) {
+    for (int mask = 0; mask < 1 << 3; mask++) {
+        std::array<float, 3> vertex;
+        for (int pos = 0; pos < 3; pos++) {
+            if (mask & (1 << pos))
+                vertex[pos] = boundary.mins[pos];
+            else
+                vertex[pos] = boundary.maxs[pos];
+        }
+        addVertex(vertex);
+    }
+
+    for (int mask = 0; mask < 1 << 3; mask++) {
+        for (int pos = 0; pos < 3; pos++) {
+            if (mask & (1 << pos))
+                continue;
+            int mask2 = mask | (1 << pos);
+            indices.push_back(mask);
+            indices.push_back(mask2);
+        }
+    }
+
+    newVIndex = 8 * 3;
+    isDirty = true;
+}
+
+void OctreeLines::nodeAdded(const OctreeNode* node) {
+    const Box boundary = node->boundary();
+    const auto& mins = boundary.mins;
+    const auto& maxs = boundary.maxs;
+    const auto center = boundary.getCenter();
+    bool isModifying;
+    int vIndex;
+    if (deletedVIndex.empty()) {
+        isModifying = false;
+        vIndex = newVIndex;
+        newVIndex += 18 * 3;
+    }
+    else {
+        isModifying = true;
+        vIndex = deletedVIndex.back();
+        deletedVIndex.pop_back();
+    }
+
+    // when appending the vertices to the end
+    // vIndex = 8 * 3 + nodeID * 18 * 3; // 6 + 4*3 = 18 new vertices
+    int offset = 0;
+    auto updateVertexBuffer = [&](const std::array<float, 3>& vertex) {
+        if (isModifying) {
+            insertVertex(vIndex + offset, vertex);
+            offset += 3;
+        }
+        else
+            addVertex(vertex);
+    };
+
+    // center lines
+    for (int i = 0; i < 3; i++) {
+        std::array<float, 3> vertexMin, vertexMax;
+        for (int j = 0; j < 3; j++) {
+            if (i == j) {
+                vertexMin[j] = mins[j];
+                vertexMax[j] = maxs[j];
+            }
+            else {
+                vertexMin[j] = center[j];
+                vertexMax[j] = center[j];
+            }
+        }
+        updateVertexBuffer(vertexMin);
+        updateVertexBuffer(vertexMax);
+    }
+
+    // boundary lines
+    std::array<int, 4> masks{ 0, 1, 3, 2 };
+    for (int i = 0; i < 3; i++) {
+        std::array<float, 3> vertex;
+        for(int mask: masks){
+            int pos = 0;
+            for (int j = 0; j < 3; j++) {
+                if(i == j){
+                    vertex[j] = center[i];
+                }
+                else {
+                    if (mask & (1 << pos++))
+                        vertex[j] = mins[j];
+                    else
+                        vertex[j] = maxs[j];
+                }
+            }
+            updateVertexBuffer(vertex);
+        }
+    }
+
+    // here, we care about # of vertices, not # of vertice coordinates
+    vIndex /= 3;
+    for (int i = 0; i < 6; i+=2) {
+        addIndex(vIndex + i);
+        addIndex(vIndex + i + 1);
+    }
+    for (int i = 6; i < 18; i += 4) {
+        for (int j = i; j < i + 3; j++) {
+            addIndex(vIndex + j);
+            addIndex(vIndex + j + 1);
+        }
+        addIndex(vIndex + i + 3);
+        addIndex(vIndex + i);
+    }
+
+    position[node] = nodes.size();
+    nodes.push_back(node);
+    isDirty = true;
+}
+
+// overwrite the vbo and ibo
+// -- move the last vertices and indices
+void OctreeLines::nodeRemoved(const OctreeNode* node) {
+    auto it = position.find(node);
+    assert(it != position.end());
+    int i = it->second;
+    position.erase(it);
+    int iIndex = i * 15 * 2 + 12 * 2;
+    deletedVIndex.push_back(indices[iIndex] * 3);
+    if (nodes.back() == node) {
+        assert(iIndex + 15 * 2 == (int)indices.size());
+        nodes.pop_back();
+        for (int j = 0; j < 15 * 2; j++)
+            indices.pop_back();
+    }
+    else {
+        auto node2 = nodes.back();
+        nodes.pop_back();
+        nodes[i] = node2;
+        position[node2] = i;
+        // 3 + 4*3 = 15 lines per center
+        for (int j = 15 * 2 - 1; j >= 0; j--) {
+            indices[iIndex + j] = indices.back();
+            indices.pop_back();
+        }
+    }
+    isDirty = true;
+}
+
+void OctreeLines::draw(const glm::mat4& projMat, const glm::mat4& viewMat) {
+    if (isDirty) {
+        updateBuffer();
+        isDirty = false;
+    }
+
+    glUseProgram(shader.programID);
+
+    // model matrix is simply identity
+    glm::mat4 vpMat = projMat * viewMat;
+    glUniformMatrix4fv(shader.vpMatID, 1, GL_FALSE, &vpMat[0][0]);
+    glUniform3fv(shader.lineColorID, 1, &lineColor[0]);
+
+    glBindVertexArray(vertexArrayID);
+
+    glDrawElements(
+        GL_LINES,          // mode
+        indices.size(),    // count
+        GL_UNSIGNED_INT,   // type
+        (void*)0           // element array buffer offset
+    );
+
+    glUseProgram(0);
+    glBindVertexArray(0);
+}
+
+void OctreeLines::updateBuffer(){
+    glBindVertexArray(vertexArrayID);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
+    glBindVertexArray(0);
+}
+
+void OctreeLines::bind(){
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+
+    glGenBuffers(1, &vertexBufferID);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(
+        0,                  // attribute #
+        3,                  // size
+        GL_FLOAT,           // type
+        GL_FALSE,           // normalized?
+        0,                  // stride
+        (void*)0            // array buffer offset
+    );
+
+    glGenBuffers(1, &elementBufferID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDisableVertexAttribArray(0);
+}
+
+void OctreeLines::addVertex(const std::array<float, 3>& vertex) {
+    for (int i = 0; i < 3; i++)
+        vertices.push_back(vertex[i]);
+}
+void OctreeLines::insertVertex(int index, const std::array<float, 3>& vertex) {
+    for (int i = 0; i < 3; i++)
+        vertices[index+i] = vertex[i];
+}
+void OctreeLines::addIndex(int index) {
+    indices.push_back(index);
+}
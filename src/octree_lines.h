@@ -0,0 +1,52 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "octree.h"
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+// the structure of an octree as lines, kept up to date while attached to it
+// attach it only while the octree is drawn, so that the octree costs nothing to draw otherwise
+class OctreeLines : public OctreeObserver {
+public:
+	OctreeLines() {}
+	OctreeLines(const OctreeLines&) = delete;
+	OctreeLines& operator=(const OctreeLines&) = delete;
+	~OctreeLines();
+	// needs a GL context
+	void init();
+
+	void attach(Octree& octree);
+	void detach();
+	void draw(const glm::mat4& projMat, const glm::mat4& viewMat);
+
+	void nodeAdded(const OctreeNode* node) override;
+	void nodeRemoved(const OctreeNode* node) override;
+private:
+	Octree* octree{ nullptr };
+
+	const glm::vec3 lineColor{ 0.7f, 0.7f, 0.7f };
+	std::vector<GLfloat> vertices;
+	std::vector<unsigned int> indices;
+	GLuint vertexArrayID{ 0 }, vertexBufferID{ 0 }, elementBufferID{ 0 };
+	LineShader shader;
+	void bind();
+	void generateBoundary(const Box& boundary);
+
+	void insertVertex(int index, const std::array<float, 3>& vertex);
+	void addVertex(const std::array<float, 3>& vertex);
+	void addIndex(int index);
+
+	bool isDirty{ false };
+	void updateBuffer();
+
+	int newVIndex{0};
+	std::vector<int> deletedVIndex;
+	// the index buffer is configured in the order of nodes
+	std::vector<const OctreeNode*> nodes;
+	std::unordered_map<const OctreeNode*, int> position; // in nodes
+};
@@ -0,0 +1,194 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Profiler profiler;
+Timeline timeline;
+
+const char* name(ProfilePhase phase) {
+    switch (phase) {
+    case ProfilePhase::FRAME: return "frame";
+    case ProfilePhase::CAMERA: return "camera";
+    case ProfilePhase::SIMULATION: return "simulation";
+    case ProfilePhase::DRAW: return "draw";
+    case ProfilePhase::SWAP: return "swap";
+    case ProfilePhase::OCTREE_INSERT: return "octree.insert";
+    case ProfilePhase::OCTREE_REMOVE: return "octree.remove";
+    case ProfilePhase::OCTREE_UPDATE: return "octree.update";
+    case ProfilePhase::OCTREE_MOVE: return "octree.move";
+    case ProfilePhase::OCTREE_SWEEP: return "octree.sweep";
+    case ProfilePhase::OCTREE_INTERSECTS: return "octree.intersects";
+    case ProfilePhase::OCTREE_RAY_QUERY: return "octree.rayQuery";
+    case ProfilePhase::OCTREE_REBUILD: return "octree.rebuild";
+    case ProfilePhase::OCTREE_RESTRUCTURE: return "octree.restructure";
+    default: return "unknown";
+    }
+}
+
+bool isOnTimeline(ProfilePhase phase) {
+    return int(phase) < int(ProfilePhase::OCTREE_INSERT) || phase == ProfilePhase::OCTREE_REBUILD
+        || phase == ProfilePhase::OCTREE_RESTRUCTURE;
+}
+
+// values below SUB_BUCKETS have a bucket each,
+// the others by their highest bit and the SUB_BUCKETS values of the bits below it
+int LatencyHistogram::bucketOf(long long ns) {
+    if (ns < SUB_BUCKETS)
+        return int(std::max(ns, 0LL));
+    const int exponent = std::ilogb(double(ns));
+    const int shift = exponent - 3; // SUB_BUCKETS = 1 << 3
+    return (exponent - 2) * SUB_BUCKETS + int((ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+long long LatencyHistogram::upperBound(int bucket) {
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    const int exponent = bucket / SUB_BUCKETS + 2;
+    const int shift = exponent - 3;
+    const long long lower = (long long)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + (1LL << shift) - 1;
+}
+
+void LatencyHistogram::add(long long ns) {
+    buckets[bucketOf(ns)]++;
+    count++;
+    total += ns;
+    max = std::max(max, ns);
+}
+
+void LatencyHistogram::clear() {
+    *this = LatencyHistogram();
+}
+
+long long LatencyHistogram::percentile(double p) const {
+    if (count == 0)
+        return 0;
+    const long long rank = std::max(1LL, (long long)std::ceil(p * count));
+    long long seen = 0;
+    for (int i = 0; i < (int)buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(upperBound(i), max);
+    }
+    return max;
+}
+
+void Profiler::add(ProfilePhase phase, std::chrono::steady_clock::duration duration) {
+    histograms[int(phase)].add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+void Profiler::clear() {
+    for (auto& histogram : histograms)
+        histogram.clear();
+}
+
+void Profiler::writeJson(std::ostream& out) const {
+    auto us = [](long long ns) { return ns / 1000.0; };
+    out << "{";
+    bool isFirst = true;
+    for (int i = 0; i < NUM_PROFILE_PHASES; i++) {
+        const LatencyHistogram& histogram = histograms[i];
+        if (histogram.count == 0)
+            continue;
+        out << (isFirst ? "\n" : ",\n")
+            << "  \"" << name(ProfilePhase(i)) << "\": {"
+            << "\"count\": " << histogram.count
+            << ", \"total_ms\": " << histogram.total / 1e6
+            << ", \"p50_us\": " << us(histogram.percentile(0.50))
+            << ", \"p95_us\": " << us(histogram.percentile(0.95))
+            << ", \"p99_us\": " << us(histogram.percentile(0.99))
+            << ", \"max_us\": " << us(histogram.max)
+            << "}";
+        isFirst = false;
+    }
+    out << "\n}" << std::endl;
+}
+
+bool Profiler::writeJson(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "can't open " << path << std::endl;
+        return false;
+    }
+    writeJson(out);
+    return true;
+}
+
+void Timeline::start(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    origin = std::chrono::steady_clock::now();
+    events.clear();
+    events.resize(std::max<size_t>(capacity, 1));
+    next = 0;
+    isFull = false;
+    isOn = true;
+}
+
+void Timeline::stop() {
+    isOn = false;
+}
+
+// threads are numbered in the order they add their first event
+int threadNumber() {
+    static std::atomic<int> threads{ 0 };
+    thread_local const int number = threads++;
+    return number;
+}
+
+void Timeline::add(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end, const TimelineArgs& args) {
+    using std::chrono::nanoseconds;
+    const int thread = threadNumber();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isOn)
+        return;
+    events[next] = { name, category, std::chrono::duration_cast<nanoseconds>(start - origin).count(),
+        std::chrono::duration_cast<nanoseconds>(end - start).count(), thread, args };
+    next++;
+    if (next == events.size()) {
+        next = 0;
+        isFull = true;
+    }
+}
+
+void Timeline::writeJson(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    const size_t count = isFull ? events.size() : next;
+    const size_t first = isFull ? next : 0;
+    for (size_t i = 0; i < count; i++) {
+        const Event& event = events[(first + i) % events.size()];
+        // complete events, in us
+        out << (i == 0 ? "\n" : ",\n")
+            << "{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category << "\", \"ph\": \"X\""
+            << ", \"ts\": " << event.startNs / 1000.0 << ", \"dur\": " << event.durationNs / 1000.0
+            << ", \"pid\": 1, \"tid\": " << event.thread;
+        if (event.args[0].first != nullptr) {
+            out << ", \"args\": {";
+            for (int j = 0; j < (int)event.args.size() && event.args[j].first != nullptr; j++)
+                out << (j == 0 ? "" : ", ") << '"' << event.args[j].first << "\": " << event.args[j].second;
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n]}" << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool Timeline::writeJson(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "can't open " << path << std::endl;
+        return false;
+    }
+    writeJson(out);
+    return true;
+}
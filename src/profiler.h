@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// build with OCTREE_PROFILING=1 to time the phases below, the timers compile to nothing otherwise
+#ifndef OCTREE_PROFILING
+#define OCTREE_PROFILING 0
+#endif
+constexpr bool isProfiling = OCTREE_PROFILING;
+
+enum class ProfilePhase {
+    // of the demo, the simulation is part of every driver
+    // these are on the timeline as well
+    FRAME,
+    CAMERA,
+    SIMULATION,
+    DRAW,
+    SWAP,
+    // of the octree, nested operations (e.g. the insertion of an update) count for both
+    OCTREE_INSERT,
+    OCTREE_REMOVE,
+    OCTREE_UPDATE,
+    OCTREE_MOVE,
+    OCTREE_SWEEP,
+    OCTREE_INTERSECTS,
+    OCTREE_RAY_QUERY,
+    OCTREE_REBUILD,
+    OCTREE_RESTRUCTURE,
+};
+
+constexpr int NUM_PROFILE_PHASES = 14;
+
+const char* name(ProfilePhase phase);
+// the octree operations are too many to be on the timeline one by one, the phases around them say how many there were
+// rebuilds and restructures are few and long, so they are on it
+bool isOnTimeline(ProfilePhase phase);
+
+// latencies in ns, in buckets of a power of two split in SUB_BUCKETS, i.e. percentiles are within 12.5%
+class LatencyHistogram {
+public:
+    void add(long long ns);
+    void clear();
+    // the upper bound of the bucket of the percentile, p in [0, 1]
+    long long percentile(double p) const;
+
+    long long count{ 0 };
+    long long total{ 0 };
+    long long max{ 0 };
+private:
+    static constexpr int SUB_BUCKETS = 8;
+    std::array<long long, 64 * SUB_BUCKETS> buckets{};
+    static int bucketOf(long long ns);
+    static long long upperBound(int bucket);
+};
+
+// latencies of every phase, not thread-safe
+class Profiler {
+public:
+    void add(ProfilePhase phase, std::chrono::steady_clock::duration duration);
+    const LatencyHistogram& histogram(ProfilePhase phase) const { return histograms[int(phase)]; }
+    void clear();
+
+    // count, total, p50, p95, p99 and max of the phases timed at least once
+    void writeJson(std::ostream& out) const;
+    bool writeJson(const std::string& path) const;
+private:
+    std::array<LatencyHistogram, NUM_PROFILE_PHASES> histograms;
+};
+
+extern Profiler profiler;
+
+// named values shown with an event, unused ones have no name
+using TimelineArgs = std::array<std::pair<const char*, long long>, 3>;
+
+// the last events (spans of time) of every thread, written in the chrome trace event format
+// to be seen in chrome://tracing or Perfetto
+class Timeline {
+public:
+    // drops the events so far, then keeps the last capacity of them
+    void start(size_t capacity = 1 << 16);
+    void stop();
+    bool isRecording() const { return isOn; }
+
+    void add(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end, const TimelineArgs& args = {});
+
+    void writeJson(std::ostream& out) const;
+    bool writeJson(const std::string& path) const;
+private:
+    struct Event {
+        const char* name;
+        const char* category;
+        long long startNs; // since the origin
+        long long durationNs;
+        int thread;
+        TimelineArgs args;
+    };
+    std::atomic<bool> isOn{ false };
+    std::chrono::steady_clock::time_point origin;
+    // a ring buffer, next is the oldest event once it is full
+    std::vector<Event> events;
+    size_t next{ 0 };
+    bool isFull{ false };
+    mutable std::mutex mutex;
+};
+
+extern Timeline timeline;
+
+// times its scope as the phase, and puts it on the timeline while it records
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfilePhase phase) : phase(phase) {
+        if constexpr (isProfiling)
+            start = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if constexpr (isProfiling) {
+            const auto end = std::chrono::steady_clock::now();
+            profiler.add(phase, end - start);
+            if (timeline.isRecording() && isOnTimeline(phase))
+                timeline.add(name(phase), "phase", start, end, args);
+        }
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // shown with the event on the timeline, up to 3 of them
+    void arg(const char* name, long long value) {
+        if constexpr (isProfiling) {
+            for (auto& arg : args) {
+                if (arg.first == nullptr || arg.first == name) {
+                    arg = { name, value };
+                    return;
+                }
+            }
+        }
+    }
+private:
+    const ProfilePhase phase;
+    std::chrono::steady_clock::time_point start;
+    TimelineArgs args{};
+};
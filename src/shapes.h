@@ -0,0 +1,750 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#if defined(_M_X64) || defined(__x86_64__)
+#define SHAPES_SSE
+#include <xmmintrin.h>
+#endif
+
+struct Box {
+    std::array<float, 3> mins;
+    std::array<float, 3> maxs;
+    Box() : mins{}, maxs{} {}
+    Box(float x1, float y1, float z1, float x2, float y2, float z2)
+        : mins{ x1, y1, z1 }, maxs{ x2, y2, z2 }{}
+    Box(const std::array<float, 3>& mins, const std::array<float, 3>& maxs)
+        : mins(mins), maxs(maxs) {}
+    Box(const Box& box)
+        : mins(box.mins), maxs(box.maxs) {}
+    std::array<float, 3> getCenter() const;
+};
+
+enum class SolidBodyType {
+    SPHERE,
+    CUBE,
+    ORIENTED_CUBE,
+    CAPSULE,
+};
+
+constexpr int NUM_SOLID_BODY_TYPES = 4;
+
+// shapes as plain values, one type per SolidBodyType
+// every test below is an overload per shape (pair), so callers that know the types get it inlined
+// a new shape needs its type here, a case in GeometryStore::visitType, and the overloads below
+struct SphereShape {
+    glm::vec3 center;
+    float radius;
+};
+
+// axis-aligned
+struct CubeShape {
+    glm::vec3 center;
+    float halfside;
+};
+
+struct OrientedCubeShape {
+    glm::vec3 center;
+    float halfside;
+    glm::mat3 axes; // world space, as columns
+    glm::vec3 reach; // half size of the enclosing box
+};
+
+// the points within radius of the segment a-b
+// a segment is a capsule of radius 0
+struct CapsuleShape {
+    glm::vec3 a, b;
+    float radius;
+};
+
+inline Box bounds(const SphereShape& s) {
+    return Box(s.center[0] - s.radius, s.center[1] - s.radius, s.center[2] - s.radius,
+        s.center[0] + s.radius, s.center[1] + s.radius, s.center[2] + s.radius);
+}
+
+inline Box bounds(const CubeShape& c) {
+    return Box(c.center[0] - c.halfside, c.center[1] - c.halfside, c.center[2] - c.halfside,
+        c.center[0] + c.halfside, c.center[1] + c.halfside, c.center[2] + c.halfside);
+}
+
+inline Box bounds(const OrientedCubeShape& c) {
+    return Box(c.center[0] - c.reach[0], c.center[1] - c.reach[1], c.center[2] - c.reach[2],
+        c.center[0] + c.reach[0], c.center[1] + c.reach[1], c.center[2] + c.reach[2]);
+}
+
+inline OrientedCubeShape oriented(const CubeShape& c) {
+    return { c.center, c.halfside, glm::mat3(1.0f), glm::vec3(c.halfside) };
+}
+
+// half size of the box enclosing the cube with the given halfside and axes
+inline glm::vec3 reachOf(float halfside, const glm::mat3& axes) {
+    return halfside * (glm::abs(axes[0]) + glm::abs(axes[1]) + glm::abs(axes[2]));
+}
+
+// the boxes overlap on every axis, grown by MARGIN
+inline bool intersectss(const Box& box1, const Box& box2, const float MARGIN) {
+    // the boxes overlap iff their intervals overlap on every axis, grown by the margin
+#ifdef SHAPES_SSE
+    // the three axes side by side, the fourth lane always passes
+    __m128 mins1 = _mm_setr_ps(box1.mins[0], box1.mins[1], box1.mins[2], 0.0f);
+    __m128 maxs1 = _mm_setr_ps(box1.maxs[0], box1.maxs[1], box1.maxs[2], 1.0f);
+    __m128 mins2 = _mm_setr_ps(box2.mins[0], box2.mins[1], box2.mins[2], 0.0f);
+    __m128 maxs2 = _mm_setr_ps(box2.maxs[0], box2.maxs[1], box2.maxs[2], 1.0f);
+    __m128 margin = _mm_set1_ps(MARGIN);
+    __m128 overlap = _mm_and_ps(_mm_cmplt_ps(mins1, _mm_add_ps(maxs2, margin)),
+        _mm_cmplt_ps(_mm_sub_ps(mins2, margin), maxs1));
+    return _mm_movemask_ps(overlap) == 0xf;
+#else
+    bool overlap = true;
+    for (int i = 0; i < 3; i++)
+        overlap &= (box1.mins[i] < box2.maxs[i] + MARGIN) & (box2.mins[i] - MARGIN < box1.maxs[i]);
+    return overlap;
+#endif
+}
+
+inline float distance(const glm::vec3& point, const Box& box) {
+    glm::vec3 diff;
+    for (int i = 0; i < 3; i++)
+        diff[i] = std::max({ box.mins[i] - point[i], 0.0f, point[i] - box.maxs[i] });
+    return glm::length(diff);
+}
+
+inline bool intersectss(const SphereShape& sphere, const Box& box, const float MARGIN) {
+    // each dimension is divided by 3: left-outside, inside, right-outside
+    // so the box subdivides the whole space by 27 pieces
+    // the closest point of the box clamps the center on each axis
+    // compare the distance to radius
+    glm::vec3 diff;
+    for (int i = 0; i < 3; i++)
+        diff[i] = std::min(std::max(sphere.center[i], box.mins[i]), box.maxs[i]) - sphere.center[i];
+    float dist2 = glm::dot(diff, diff);
+    float r = sphere.radius + MARGIN;
+    return dist2 < r * r;
+}
+
+inline bool intersectss(const CubeShape& cube, const Box& box, const float MARGIN) {
+    return intersectss(bounds(cube), box, MARGIN);
+}
+
+// an oriented cube is registered (and pruned) by its enclosing box,
+// so that traversals cost the same as for axis-aligned objects
+inline bool intersectss(const OrientedCubeShape& cube, const Box& box, const float MARGIN) {
+    return intersectss(bounds(cube), box, MARGIN);
+}
+
+// separating axis test: the largest gap between the projections of the cubes
+// over the 15 candidate axes (the axes of both and their cross products), negative while overlapping
+inline float separation(const OrientedCubeShape& cube1, const OrientedCubeShape& cube2) {
+    // the axes of cube2 in the frame of cube1
+    constexpr float EPS = 0.000'001f;
+    float r[3][3], absR[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            r[i][j] = glm::dot(cube1.axes[i], cube2.axes[j]);
+            // keeps nearly parallel edges from producing a false separation
+            absR[i][j] = std::abs(r[i][j]) + EPS;
+        }
+    }
+    const glm::vec3 d = cube2.center - cube1.center;
+    const float t[3] = { glm::dot(d, cube1.axes[0]), glm::dot(d, cube1.axes[1]), glm::dot(d, cube1.axes[2]) };
+    const float h1 = cube1.halfside, h2 = cube2.halfside;
+
+    float gap = -std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; i++)
+        gap = std::max(gap, std::abs(t[i]) - h1 - h2 * (absR[i][0] + absR[i][1] + absR[i][2]));
+    for (int j = 0; j < 3; j++) {
+        float proj = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+        gap = std::max(gap, std::abs(proj) - h1 * (absR[0][j] + absR[1][j] + absR[2][j]) - h2);
+    }
+    for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++) {
+            int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            // the cross product is not a unit vector, the gap is scaled back by its length
+            float len = std::sqrt(std::max(0.0f, 1 - r[i][j] * r[i][j]));
+            if (len < 0.001f)
+                continue;
+            float ra = h1 * (absR[i2][j] + absR[i1][j]);
+            float rb = h2 * (absR[i][j2] + absR[i][j1]);
+            float proj = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+            gap = std::max(gap, (std::abs(proj) - ra - rb) / len);
+        }
+    }
+    return gap;
+}
+
+// a point in the frame of the cube
+inline glm::vec3 toLocal(const OrientedCubeShape& cube, const glm::vec3& point) {
+    return glm::transpose(cube.axes) * (point - cube.center);
+}
+
+inline Box localBox(const OrientedCubeShape& cube) {
+    float h = cube.halfside;
+    return Box(-h, -h, -h, h, h, h);
+}
+
+inline bool intersectss(const OrientedCubeShape& cube1, const OrientedCubeShape& cube2, const float MARGIN) {
+    return separation(cube1, cube2) < MARGIN;
+}
+
+inline bool intersectss(const OrientedCubeShape& cube1, const CubeShape& cube2, const float MARGIN) {
+    return separation(cube1, oriented(cube2)) < MARGIN;
+}
+
+inline bool intersectss(const CubeShape& cube1, const OrientedCubeShape& cube2, const float MARGIN) {
+    return separation(oriented(cube1), cube2) < MARGIN;
+}
+
+inline bool intersectss(const SphereShape& sphere, const OrientedCubeShape& cube, const float MARGIN) {
+    return intersectss(SphereShape{ toLocal(cube, sphere.center), sphere.radius }, localBox(cube), MARGIN);
+}
+
+inline bool intersectss(const OrientedCubeShape& cube, const SphereShape& sphere, const float MARGIN) {
+    return intersectss(sphere, cube, MARGIN);
+}
+
+inline bool intersectss(const SphereShape& sphere1, const SphereShape& sphere2, const float MARGIN) {
+    glm::vec3 diff = sphere1.center - sphere2.center;
+    float dist2 = glm::dot(diff, diff);
+    float r = sphere1.radius + sphere2.radius + MARGIN;
+    return dist2 < r * r;
+}
+
+inline bool intersectss(const SphereShape& sphere, const CubeShape& cube, const float MARGIN) {
+    return intersectss(sphere, bounds(cube), MARGIN);
+}
+
+inline bool intersectss(const CubeShape& cube, const SphereShape& sphere, const float MARGIN) {
+    return intersectss(sphere, bounds(cube), MARGIN);
+}
+
+inline bool intersectss(const CubeShape& cube1, const CubeShape& cube2, const float MARGIN) {
+    return intersectss(bounds(cube1), bounds(cube2), MARGIN);
+}
+
+// the shape is inside the box, shrunk by MARGIN
+template <typename Shape>
+bool containedIn(const Shape& shape, const Box& box, const float MARGIN) {
+    Box b = bounds(shape);
+    for (int i = 0; i < 3; i++) {
+        if (b.maxs[i] > box.maxs[i] - MARGIN)
+            return false;
+        if (b.mins[i] < box.mins[i] + MARGIN)
+            return false;
+    }
+    return true;
+}
+
+// if returns yes, the intersection is from + [t1Out...t2Out] * (to-from)
+inline bool intersectss(const Box& box, const glm::vec3& from, const glm::vec3& to, float& t1, float& t2) {
+    // project to each axis, i.e., parametrize min[i] and max[i] by from[i] + t*diff[i]
+    // the query range t is the overlapping part of those intervals
+
+    t1 = 0;
+    t2 = 1;
+
+    glm::vec3 diff = to - from;
+    for (int i = 0; i < 3; i++) {
+        if (from[i] == to[i]) {
+            if (from[i] < box.mins[i] || box.maxs[i] < from[i])
+                return false;
+        }
+        else if (from[i] < to[i]) {
+            if (box.maxs[i] < from[i])
+                return false;
+            if (box.mins[i] > to[i])
+                return false;
+            t1 = std::max(t1, (box.mins[i] - from[i]) / diff[i]);
+            t2 = std::min(t2, (box.maxs[i] - from[i]) / diff[i]);
+        }
+        else { // from[i] > to[i]
+            if (box.mins[i] > from[i])
+                return false;
+            if (box.maxs[i] < to[i])
+                return false;
+            t1 = std::max(t1, (box.maxs[i] - from[i]) / diff[i]);
+            t2 = std::min(t2, (box.mins[i] - from[i]) / diff[i]);
+        }
+    }
+
+    if (t1 > t2)
+        return false;
+    else
+        return true;
+}
+
+inline bool intersectss(const SphereShape& sphere, const glm::vec3& from, const glm::vec3& to, float& t1, float& t2) {
+    // project diff to direction
+    glm::vec3 direction = to - from;
+    glm::vec3 diff = sphere.center - from;
+    float len = glm::length(direction);
+    // r^2 = h^2 + a^2
+    // diff^2 = h^2 + proj^2
+    // r^2 - diff^2 = a^2 - proj^2
+    // a^2 = r^2 - diff^2 + proj^2
+    //
+    // t = [proj - a .. proj + a]
+
+    float a = sphere.radius * sphere.radius;
+    a -= glm::dot(diff, diff);
+    float proj = dot(direction, diff) / len;
+    a += proj * proj;
+    constexpr float EPS = 0.000'001f;
+    if (a <= EPS)
+        return false;
+    a = std::sqrt(a);
+    float th = proj / len;
+    t1 = std::max(0.0f, th - a/len);
+    t2 = std::min(1.0f, th + a/len);
+    if (t1 > 1 || t2 < 0)
+        return false;
+    else
+        return true;
+}
+
+inline bool intersectss(const CubeShape& cube, const glm::vec3& from, const glm::vec3& to, float& t1, float& t2) {
+    return intersectss(bounds(cube), from, to, t1, t2);
+}
+
+inline bool intersectss(const OrientedCubeShape& cube, const glm::vec3& from, const glm::vec3& to, float& t1, float& t2) {
+    // the segment in the frame of the cube keeps its parametrization
+    return intersectss(localBox(cube), toLocal(cube, from), toLocal(cube, to), t1, t2);
+}
+
+// separation is a convex function of t in [0, 1], non-positive while touching,
+// and changes by at most speed over [0, 1], e.g. a distance with speed the length of the displacement
+// for the pairs without a closed form below
+template <typename F>
+bool firstContact(F separation, float speed, float& tOut) {
+    constexpr int ITERATIONS = 30;
+    // the contact is found to within this distance
+    constexpr float TOLERANCE = 0.000'1f;
+
+    const float initial = separation(0.0f);
+    if (initial <= 0) {
+        // already touching: counts only while approaching
+        tOut = 0.0f;
+        return separation(0.001f) < initial;
+    }
+    // out of reach of the displacement
+    if (initial > speed)
+        return false;
+
+    // ternary search for the closest approach, until a touching point is found or the approach is out of reach
+    float lo = 0.0f, hi = 1.0f;
+    float touching = -1.0f;
+    for (int i = 0; i < ITERATIONS && touching < 0; i++) {
+        float m1 = lo + (hi - lo) / 3;
+        float m2 = hi - (hi - lo) / 3;
+        float s1 = separation(m1), s2 = separation(m2);
+        if (s1 <= 0)
+            touching = m1;
+        else if (s2 <= 0)
+            touching = m2;
+        else if (std::min(s1, s2) > speed * (hi - lo))
+            return false;
+        else if (s1 < s2)
+            hi = m2;
+        else
+            lo = m1;
+        if ((hi - lo) * speed < TOLERANCE)
+            break;
+    }
+    if (touching < 0) {
+        touching = (lo + hi) / 2;
+        if (separation(touching) > 0)
+            return false;
+    }
+
+    // bisection for the first contact, keeping lo apart
+    lo = 0.0f;
+    hi = touching;
+    for (int i = 0; i < ITERATIONS && (hi - lo) * speed > TOLERANCE; i++) {
+        float mid = (lo + hi) / 2;
+        if (separation(mid) > 0)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    tOut = lo;
+    return true;
+}
+
+// if returns yes, the first shape translated by tOut * displacement is the first to touch the second one
+// shapes already touching do not count if they are separating
+inline bool sweeps(const SphereShape& sphere1, const glm::vec3& displacement, const SphereShape& sphere2, float& tOut, const float MARGIN) {
+    // |p + t * displacement| = r, a quadratic a t^2 + 2 b t + c
+    const glm::vec3 p = sphere1.center - sphere2.center;
+    const float r = sphere1.radius + sphere2.radius + MARGIN;
+    const float a = glm::dot(displacement, displacement);
+    const float b = glm::dot(p, displacement);
+    const float c = glm::dot(p, p) - r * r;
+    if (c <= 0) {
+        tOut = 0.0f;
+        return b < 0;
+    }
+    if (b >= 0)
+        return false;
+    const float disc = b * b - a * c;
+    if (disc < 0)
+        return false;
+    // the smaller root, as c over the larger one for precision
+    const float t = c / (-b + std::sqrt(disc));
+    if (t > 1)
+        return false;
+    tOut = t;
+    return true;
+}
+
+inline bool sweeps(const CubeShape& cube1, const glm::vec3& displacement, const CubeShape& cube2, float& tOut, const float MARGIN) {
+    // touching while |p + t * displacement| <= h on every axis, i.e. in the intersection of an interval per axis
+    const glm::vec3 p = cube1.center - cube2.center;
+    const float h = cube1.halfside + cube2.halfside + MARGIN;
+    const float gap = std::max({ std::abs(p[0]), std::abs(p[1]), std::abs(p[2]) });
+    if (gap <= h) {
+        // approaching along every axis of the largest gap
+        bool isApproaching = true;
+        for (int i = 0; i < 3; i++) {
+            if (std::abs(p[i]) == gap)
+                isApproaching = isApproaching && p[i] * displacement[i] < 0;
+        }
+        tOut = 0.0f;
+        return isApproaching;
+    }
+    float enter = 0.0f, exit = 1.0f;
+    for (int i = 0; i < 3; i++) {
+        if (displacement[i] == 0) {
+            if (std::abs(p[i]) > h)
+                return false;
+            continue;
+        }
+        float t1 = (-h - p[i]) / displacement[i];
+        float t2 = (h - p[i]) / displacement[i];
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+    }
+    if (enter > exit)
+        return false;
+    tOut = enter;
+    return true;
+}
+
+// the separating axis gap is a maximum of convex functions of t, so it is convex as well
+inline bool sweeps(const OrientedCubeShape& cube1, const glm::vec3& displacement, const OrientedCubeShape& cube2, float& tOut, const float MARGIN) {
+    return firstContact([&](float t) {
+        OrientedCubeShape moved = cube1;
+        moved.center += displacement * t;
+        return separation(moved, cube2) - MARGIN;
+    }, glm::length(displacement), tOut);
+}
+
+inline bool sweeps(const OrientedCubeShape& cube1, const glm::vec3& displacement, const CubeShape& cube2, float& tOut, const float MARGIN) {
+    return sweeps(cube1, displacement, oriented(cube2), tOut, MARGIN);
+}
+
+inline bool sweeps(const CubeShape& cube1, const glm::vec3& displacement, const OrientedCubeShape& cube2, float& tOut, const float MARGIN) {
+    return sweeps(oriented(cube1), displacement, cube2, tOut, MARGIN);
+}
+
+inline Box bounds(const CapsuleShape& c) {
+    Box box;
+    for (int i = 0; i < 3; i++) {
+        box.mins[i] = std::min(c.a[i], c.b[i]) - c.radius;
+        box.maxs[i] = std::max(c.a[i], c.b[i]) + c.radius;
+    }
+    return box;
+}
+
+inline float distance(const glm::vec3& point, const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 ab = b - a;
+    float len2 = glm::dot(ab, ab);
+    float t = len2 > 0 ? std::min(std::max(glm::dot(point - a, ab) / len2, 0.0f), 1.0f) : 0.0f;
+    return glm::length(a + ab * t - point);
+}
+
+// between the segments p1-q1 and p2-q2
+// adapted from Ericson, Real-Time Collision Detection, 5.1.9
+inline float distance(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2) {
+    constexpr float EPS = 0.000'000'1f;
+    const glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    const float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    auto clamp01 = [](float x) { return std::min(std::max(x, 0.0f), 1.0f); };
+    float s, t;
+    if (a <= EPS && e <= EPS)
+        return glm::length(r);
+    if (a <= EPS) {
+        s = 0.0f;
+        t = clamp01(f / e);
+    }
+    else {
+        const float c = glm::dot(d1, r);
+        if (e <= EPS) {
+            t = 0.0f;
+            s = clamp01(-c / a);
+        }
+        else {
+            const float b = glm::dot(d1, d2);
+            const float denom = a * e - b * b;
+            // parallel segments: any s works, pick the start
+            s = denom > 0 ? clamp01((b * f - c * e) / denom) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0) {
+                t = 0.0f;
+                s = clamp01(-c / a);
+            }
+            else if (t > 1) {
+                t = 1.0f;
+                s = clamp01((b - c) / a);
+            }
+        }
+    }
+    return glm::length(p1 + d1 * s - p2 - d2 * t);
+}
+
+// between the segment a-b and the box
+inline float distance(const glm::vec3& a, const glm::vec3& b, const Box& box) {
+    float t1, t2;
+    if (intersectss(box, a, b, t1, t2))
+        return 0.0f;
+    // a closest point of the segment is one of its ends, or the box is closest along one of its edges:
+    // a segment closest to a face from its interior is parallel to it and can slide to an end or an edge
+    float best = std::min(distance(a, box), distance(b, box));
+    for (int k = 0; k < 3; k++) {
+        int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+        for (int corner = 0; corner < 4; corner++) {
+            glm::vec3 from, to;
+            from[k] = box.mins[k];
+            to[k] = box.maxs[k];
+            from[k1] = to[k1] = corner & 1 ? box.maxs[k1] : box.mins[k1];
+            from[k2] = to[k2] = corner & 2 ? box.maxs[k2] : box.mins[k2];
+            best = std::min(best, distance(a, b, from, to));
+        }
+    }
+    return best;
+}
+
+// the capsule in the frame of the cube
+inline CapsuleShape toLocal(const OrientedCubeShape& cube, const CapsuleShape& capsule) {
+    return { toLocal(cube, capsule.a), toLocal(cube, capsule.b), capsule.radius };
+}
+
+// a capsule is registered by its actual shape, so that a long diagonal one is not in every leaf of its enclosing box
+inline bool intersectss(const CapsuleShape& capsule, const Box& box, const float MARGIN) {
+    if (!intersectss(bounds(capsule), box, MARGIN))
+        return false;
+    return distance(capsule.a, capsule.b, box) < capsule.radius + MARGIN;
+}
+
+inline bool intersectss(const CapsuleShape& capsule1, const CapsuleShape& capsule2, const float MARGIN) {
+    return distance(capsule1.a, capsule1.b, capsule2.a, capsule2.b) < capsule1.radius + capsule2.radius + MARGIN;
+}
+
+inline bool intersectss(const CapsuleShape& capsule, const SphereShape& sphere, const float MARGIN) {
+    return distance(sphere.center, capsule.a, capsule.b) < capsule.radius + sphere.radius + MARGIN;
+}
+
+inline bool intersectss(const SphereShape& sphere, const CapsuleShape& capsule, const float MARGIN) {
+    return intersectss(capsule, sphere, MARGIN);
+}
+
+inline bool intersectss(const CapsuleShape& capsule, const CubeShape& cube, const float MARGIN) {
+    return intersectss(capsule, bounds(cube), MARGIN);
+}
+
+inline bool intersectss(const CubeShape& cube, const CapsuleShape& capsule, const float MARGIN) {
+    return intersectss(capsule, bounds(cube), MARGIN);
+}
+
+inline bool intersectss(const CapsuleShape& capsule, const OrientedCubeShape& cube, const float MARGIN) {
+    return intersectss(toLocal(cube, capsule), localBox(cube), MARGIN);
+}
+
+inline bool intersectss(const OrientedCubeShape& cube, const CapsuleShape& capsule, const float MARGIN) {
+    return intersectss(capsule, cube, MARGIN);
+}
+
+inline bool intersectss(const CapsuleShape& capsule, const glm::vec3& from, const glm::vec3& to, float& t1, float& t2) {
+    // a capsule is convex, so the segment meets it in one interval,
+    // spanning where it meets the two end spheres and the cylinder between them
+    constexpr float EPS = 0.000'001f;
+    t1 = 1.0f;
+    t2 = 0.0f;
+    auto join = [&](float s1, float s2) {
+        t1 = std::min(t1, s1);
+        t2 = std::max(t2, s2);
+    };
+    float s1, s2;
+    if (intersectss(SphereShape{ capsule.a, capsule.radius }, from, to, s1, s2))
+        join(s1, s2);
+    if (intersectss(SphereShape{ capsule.b, capsule.radius }, from, to, s1, s2))
+        join(s1, s2);
+
+    const glm::vec3 axis = capsule.b - capsule.a;
+    const float len2 = glm::dot(axis, axis);
+    if (len2 > EPS) {
+        const glm::vec3 v = to - from;
+        const glm::vec3 m = from - capsule.a;
+        // within the radius of the axis: |mPerp + s * vPerp|^2 <= r^2
+        const glm::vec3 vPerp = v - axis * (glm::dot(v, axis) / len2);
+        const glm::vec3 mPerp = m - axis * (glm::dot(m, axis) / len2);
+        const float a = glm::dot(vPerp, vPerp);
+        const float b = 2 * glm::dot(mPerp, vPerp);
+        const float c = glm::dot(mPerp, mPerp) - capsule.radius * capsule.radius;
+        float lo = 0.0f, hi = 1.0f;
+        bool isInside = true;
+        if (a < EPS)
+            isInside = c <= 0;
+        else {
+            float disc = b * b - 4 * a * c;
+            if (disc <= 0)
+                isInside = false;
+            else {
+                float sq = std::sqrt(disc);
+                lo = std::max(lo, (-b - sq) / (2 * a));
+                hi = std::min(hi, (-b + sq) / (2 * a));
+            }
+        }
+        // between the end caps: 0 <= (m + s * v) . axis <= |axis|^2
+        const float p = glm::dot(m, axis);
+        const float q = glm::dot(v, axis);
+        if (std::abs(q) < EPS)
+            isInside = isInside && 0 <= p && p <= len2;
+        else {
+            float u1 = -p / q, u2 = (len2 - p) / q;
+            lo = std::max(lo, std::min(u1, u2));
+            hi = std::min(hi, std::max(u1, u2));
+        }
+        if (isInside && lo <= hi)
+            join(lo, hi);
+    }
+    return t1 <= t2;
+}
+
+// the center of the sphere against the box rounded by the radius, i.e. the union of
+// the box grown by the radius along one axis at a time and the capsules around its 12 edges
+inline bool sweeps(const SphereShape& sphere, const glm::vec3& displacement, const Box& box, float& tOut, const float MARGIN) {
+    const float r = sphere.radius + MARGIN;
+    const glm::vec3 from = sphere.center;
+    const glm::vec3 to = from + displacement;
+    glm::vec3 closest;
+    for (int i = 0; i < 3; i++)
+        closest[i] = std::min(std::max(from[i], box.mins[i]), box.maxs[i]);
+    // the distance to the box is convex along the move, so it only shrinks while approaching the closest point,
+    // and a center inside the box gets no closer
+    // this also keeps a center just past r by rounding, e.g. at rest where a move stopped, from entering the grown box at 0
+    if (glm::dot(from - closest, displacement) >= 0)
+        return false;
+    const float initial = glm::length(from - closest);
+    if (initial <= r) {
+        tOut = 0.0f;
+        return true;
+    }
+
+    float t1, t2;
+    Box grown = box;
+    for (int i = 0; i < 3; i++) {
+        grown.mins[i] -= r;
+        grown.maxs[i] += r;
+    }
+    if (!intersectss(grown, from, to, t1, t2))
+        return false;
+    // entering through a face, the common case
+    const glm::vec3 enter = from + displacement * t1;
+    int outside = 0;
+    for (int i = 0; i < 3; i++)
+        outside += enter[i] < box.mins[i] || box.maxs[i] < enter[i];
+    if (outside <= 1) {
+        tOut = t1;
+        return true;
+    }
+
+    float first = 2.0f;
+    for (int k = 0; k < 3; k++) {
+        Box slab = box;
+        slab.mins[k] -= r;
+        slab.maxs[k] += r;
+        if (intersectss(slab, from, to, t1, t2))
+            first = std::min(first, t1);
+    }
+    for (int k = 0; k < 3; k++) {
+        int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+        for (int corner = 0; corner < 4; corner++) {
+            CapsuleShape edge{ glm::vec3(0.0f), glm::vec3(0.0f), r };
+            edge.a[k] = box.mins[k];
+            edge.b[k] = box.maxs[k];
+            edge.a[k1] = edge.b[k1] = corner & 1 ? box.maxs[k1] : box.mins[k1];
+            edge.a[k2] = edge.b[k2] = corner & 2 ? box.maxs[k2] : box.mins[k2];
+            if (intersectss(edge, from, to, t1, t2))
+                first = std::min(first, t1);
+        }
+    }
+    if (first > 1)
+        return false;
+    tOut = first;
+    return true;
+}
+
+inline bool sweeps(const SphereShape& sphere, const glm::vec3& displacement, const CubeShape& cube, float& tOut, const float MARGIN) {
+    return sweeps(sphere, displacement, bounds(cube), tOut, MARGIN);
+}
+
+inline bool sweeps(const CubeShape& cube, const glm::vec3& displacement, const SphereShape& sphere, float& tOut, const float MARGIN) {
+    // the sphere moving backwards against the cube standing still
+    return sweeps(sphere, -displacement, cube, tOut, MARGIN);
+}
+
+inline bool sweeps(const SphereShape& sphere, const glm::vec3& displacement, const OrientedCubeShape& cube, float& tOut, const float MARGIN) {
+    // in the frame of the cube, where it is a box
+    const SphereShape local{ toLocal(cube, sphere.center), sphere.radius };
+    return sweeps(local, glm::transpose(cube.axes) * displacement, localBox(cube), tOut, MARGIN);
+}
+
+inline bool sweeps(const OrientedCubeShape& cube, const glm::vec3& displacement, const SphereShape& sphere, float& tOut, const float MARGIN) {
+    return sweeps(sphere, -displacement, cube, tOut, MARGIN);
+}
+
+// the distance between convex shapes, one of them translated, is convex in t
+inline bool sweeps(const CapsuleShape& capsule1, const glm::vec3& displacement, const CapsuleShape& capsule2, float& tOut, const float MARGIN) {
+    return firstContact([&](float t) {
+        return distance(capsule1.a + displacement * t, capsule1.b + displacement * t, capsule2.a, capsule2.b)
+            - capsule1.radius - capsule2.radius - MARGIN;
+    }, glm::length(displacement), tOut);
+}
+
+inline bool sweeps(const SphereShape& sphere, const glm::vec3& displacement, const CapsuleShape& capsule, float& tOut, const float MARGIN) {
+    return firstContact([&](float t) {
+        return distance(sphere.center + displacement * t, capsule.a, capsule.b) - sphere.radius - capsule.radius - MARGIN;
+    }, glm::length(displacement), tOut);
+}
+
+inline bool sweeps(const CapsuleShape& capsule, const glm::vec3& displacement, const SphereShape& sphere, float& tOut, const float MARGIN) {
+    // the sphere moving backwards against the capsule standing still
+    return sweeps(sphere, -displacement, capsule, tOut, MARGIN);
+}
+
+inline bool sweeps(const CapsuleShape& capsule, const glm::vec3& displacement, const CubeShape& cube, float& tOut, const float MARGIN) {
+    const Box box = bounds(cube);
+    return firstContact([&](float t) {
+        return distance(capsule.a + displacement * t, capsule.b + displacement * t, box) - capsule.radius - MARGIN;
+    }, glm::length(displacement), tOut);
+}
+
+inline bool sweeps(const CubeShape& cube, const glm::vec3& displacement, const CapsuleShape& capsule, float& tOut, const float MARGIN) {
+    return sweeps(capsule, -displacement, cube, tOut, MARGIN);
+}
+
+inline bool sweeps(const CapsuleShape& capsule, const glm::vec3& displacement, const OrientedCubeShape& cube, float& tOut, const float MARGIN) {
+    const CapsuleShape local = toLocal(cube, capsule);
+    const glm::vec3 localDisplacement = glm::transpose(cube.axes) * displacement;
+    const Box box = localBox(cube);
+    return firstContact([&](float t) {
+        return distance(local.a + localDisplacement * t, local.b + localDisplacement * t, box) - capsule.radius - MARGIN;
+    }, glm::length(displacement), tOut);
+}
+
+inline bool sweeps(const OrientedCubeShape& cube, const glm::vec3& displacement, const CapsuleShape& capsule, float& tOut, const float MARGIN) {
+    return sweeps(capsule, -displacement, cube, tOut, MARGIN);
+}
@@ -0,0 +1,118 @@
+#include "simulation.h"
+#include "profiler.h"
+
+Simulation::Simulation(float maxCoordinate, float fatMargin, int capacity)
+    : octree(maxCoordinate, fatMargin, capacity), maxCoordinate(maxCoordinate) {}
+
+void Simulation::makeObjects(int N) {
+    std::uniform_real_distribution<float> rDist(MIN_SCALE, MAX_SCALE);
+    std::uniform_real_distribution<float> tDist(-maxCoordinate + MAX_SCALE * 2, maxCoordinate - MAX_SCALE * 2);
+    std::uniform_int_distribution<int> dist(0, 3);
+    std::uniform_real_distribution<float> aDist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> degreeDist(0.0f, 360.0f);
+
+    for (int i = 0; i < N; i++) {
+        while (true) {
+            int type = dist(rng);
+            float scale = rDist(rng);
+            // cube -> 2*2*2 = 8
+            // sphere -> 4/3pi ~ 4
+            // capsule -> 4/3pi + 2pi*3 ~ 23
+            if (type == 1 || type == 2)
+                scale /= 1.25f;
+            else if (type == 3)
+                scale /= 1.75f;
+            glm::vec3 trans = { tDist(rng), tDist(rng), tDist(rng) };
+
+            // in the order of SolidBodyType
+            const SolidBodyType bodyType = SolidBodyType(type);
+            if (bodyFactory)
+                objects.push_back(bodyFactory(bodyType, scale));
+            else
+                objects.push_back(std::make_unique<MovingBody>(bodyType));
+            auto object = objects.back().get();
+            if (bodyType == SolidBodyType::CAPSULE)
+                geometry.elongation[object->getID()] = CAPSULE_ELONGATION;
+            object->makeRandomMovingDirection(rng);
+            object->scale(scale);
+            if (type == 2 || type == 3)
+                object->rotate({ aDist(rng), aDist(rng), aDist(rng) + 0.001f }, degreeDist(rng));
+            object->translate(trans);
+
+            if (octree.insert(object)) {
+                awakeObjects.push_back(object);
+                break;
+            }
+            else
+                objects.pop_back();
+        }
+    }
+}
+
+void Simulation::update(const MotionInput& input, double t) {
+    ScopedTimer timer(ProfilePhase::SIMULATION);
+    const OctreeCounters before = octree.getCounters();
+    int moves = 0;
+    // an object moves until
+    // i) the object reaches the boundary
+    // ii) the object collides with other objects
+    // and then changes its direction
+
+    auto move = [&](MovingBody* object, const glm::vec3& trans) {
+        if (trace.isOpen())
+            trace.addMove(object, trans);
+        moves++;
+        if (octree.move(object, trans).t < 1.0f)
+            object->makeRandomMovingDirection(rng);
+    };
+
+    for (size_t i = 0; i < awakeObjects.size(); ) {
+        MovingBody* object = awakeObjects[i];
+        glm::vec3 trans = object->nextDisplacement(input, t);
+        if (trans != glm::vec3(0.0f)) {
+            object->restingFrames = 0;
+            move(object, trans);
+        }
+        else if (!object->isClicked && ++object->restingFrames >= SLEEP_FRAMES) {
+            object->isAsleep = true;
+            awakeObjects[i] = awakeObjects.back();
+            awakeObjects.pop_back();
+            continue;
+        }
+        i++;
+    }
+    if (trace.isOpen())
+        trace.endFrame();
+    if (octree.isDeferringRestructures())
+        octree.restructure(restructureBudget);
+
+    // the moves are a batch of octree operations on the timeline
+    timer.arg("moves", moves);
+    timer.arg("splits", octree.getCounters().splits - before.splits);
+    timer.arg("merges", octree.getCounters().merges - before.merges);
+}
+
+void Simulation::setRestructureBudget(std::chrono::microseconds budget) {
+    restructureBudget = budget;
+    octree.setDeferring(budget.count() > 0);
+}
+
+bool Simulation::maintain() {
+    if (restructureBudget.count() > 0)
+        return octree.maintain(restructureBudget);
+    return octree.maintain();
+}
+
+bool Simulation::startTrace(const std::string& path) {
+    std::vector<const Body*> bodies;
+    for (auto& object : objects)
+        bodies.push_back(object.get());
+    return trace.open(path, octree, bodies);
+}
+
+void Simulation::wake(MovingBody* object, double t) {
+    if (!object->isAsleep)
+        return;
+    object->wake(t);
+    awakeObjects.push_back(object);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "moving_body.h"
+#include "octree.h"
+#include "trace.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// randomly generated objects moving inside an octree, shared by the demo and the headless driver
+// nothing here needs GL: the demo draws the objects and turns its input into a MotionInput
+class Simulation {
+public:
+    static constexpr float CAPSULE_ELONGATION = 3.0f;
+    static constexpr float MIN_SCALE = 0.001f;
+    static constexpr float MAX_SCALE = 1.0f;
+    // an object not moving for this many frames falls asleep
+    static constexpr int SLEEP_FRAMES = 60;
+
+    Octree octree;
+    std::vector<std::unique_ptr<MovingBody>> objects;
+    std::mt19937 rng;
+    // makes an object of the type, about to be scaled by scale, e.g. with a mesh to draw it
+    // unset (by default), the objects are plain moving bodies
+    using BodyFactory = std::function<std::unique_ptr<MovingBody>(SolidBodyType type, float scale)>;
+    BodyFactory bodyFactory;
+
+    Simulation(float maxCoordinate, float fatMargin = 0.0f, int capacity = OctreeNode::CAPACITY);
+    void makeObjects(int N);
+    // moves the awake objects to time t
+    void update(const MotionInput& input, double t);
+    void wake(MovingBody* object, double t);
+    size_t numAwakeObjects() const { return awakeObjects.size(); }
+    // with a budget, the splits and merges of the moves are deferred to the end of update and done within it,
+    // so that a burst of moves does not make a slow frame; zero (by default) does them at once
+    void setRestructureBudget(std::chrono::microseconds budget);
+    // between frames, rebuilds the octree if its rebuild policy (off by default) has it due, by slices within the restructure budget if there is one
+    // true once it did
+    bool maintain();
+
+    // records the objects as they are, then the moves of every update until stopped
+    bool startTrace(const std::string& path);
+    void stopTrace() { trace.close(); }
+    bool isTracing() const { return trace.isOpen(); }
+private:
+    const float maxCoordinate;
+    // only these are moved every frame, the rest are asleep
+    std::vector<MovingBody*> awakeObjects;
+    std::chrono::microseconds restructureBudget{ 0 };
+    TraceWriter trace;
+};
@@ -3,4 +3,8 @@
 std::ostream& operator<<(std::ostream& os, const Sphere& sphere){
 	os << sphere.radius() << " (" << sphere.center()[0] << ',' << sphere.center()[1] << ',' << sphere.center()[2] << ')';
 	return os;
+}
+
+std::ostream& Sphere::print(std::ostream& os) const {
+	return os << *this;
 }
\ No newline at end of file
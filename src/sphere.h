@@ -11,8 +11,10 @@ public:
 	// using SolidBody::SolidBody;
 	Sphere(Mesh& mesh, std::mt19937& rng) : SolidBody(mesh, rng, SolidBodyType::SPHERE) {}
 
-	const glm::vec3& center() const { return worldPos[stateIndex]; }
-	float radius() const { return scaledFactor[stateIndex]; }
+	glm::vec3 center() const { return geometry.center(id); }
+	float radius() const { return geometry.extent[id]; }
+
+	std::ostream& print(std::ostream& os) const override;
 };
 
 std::ostream& operator<<(std::ostream& os, const Sphere& sphere);
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+constexpr char MAGIC[4] = { 'O', 'C', 'T', 'R' };
+constexpr uint32_t VERSION = 1;
+
+template <typename T>
+void write(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool read(std::ifstream& in, T& value) {
+    return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+void write(std::ofstream& out, const glm::vec3& v) {
+    for (int i = 0; i < 3; i++)
+        write(out, v[i]);
+}
+
+bool read(std::ifstream& in, glm::vec3& v) {
+    return read(in, v[0]) && read(in, v[1]) && read(in, v[2]);
+}
+
+bool TraceWriter::open(const std::string& path, const Octree& octree, const std::vector<const Body*>& objects) {
+    close();
+    out.open(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "can't open the trace " << path << std::endl;
+        return false;
+    }
+
+    out.write(MAGIC, sizeof(MAGIC));
+    write(out, VERSION);
+    write(out, octree.getBoundary().maxs[0]);
+    write(out, octree.getFatMargin());
+    write(out, int32_t(octree.getCapacity()));
+    write(out, uint32_t(objects.size()));
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        const int id = objects[i]->getID();
+        const Pose pose = geometry.pose(id);
+        write(out, uint8_t(geometry.type[id]));
+        write(out, pose.extent);
+        write(out, geometry.elongation[id]);
+        write(out, pose.center);
+        for (int j = 0; j < 3; j++)
+            write(out, pose.axes[j]);
+        index[objects[i]] = i;
+    }
+    return true;
+}
+
+void TraceWriter::close() {
+    if (!out.is_open())
+        return;
+    out.close();
+    index.clear();
+    moves.clear();
+}
+
+void TraceWriter::addMove(const Body* object, const glm::vec3& displacement) {
+    auto it = index.find(object);
+    assert(it != index.end());
+    moves.push_back({ it->second, displacement });
+}
+
+void TraceWriter::endFrame() {
+    write(out, uint32_t(moves.size()));
+    for (const auto& move : moves) {
+        write(out, move.index);
+        write(out, move.displacement);
+    }
+    moves.clear();
+}
+
+bool TraceReader::open(const std::string& path) {
+    in.open(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "can't open the trace " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version;
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, MAGIC) || !read(in, version) || version != VERSION) {
+        std::cerr << path << " is not a trace of this version" << std::endl;
+        return false;
+    }
+    int32_t capacity;
+    uint32_t numObjects;
+    if (!read(in, header.maxCoordinate) || !read(in, header.fatMargin) || !read(in, capacity) || !read(in, numObjects)) {
+        std::cerr << "the header of the trace is broken" << std::endl;
+        return false;
+    }
+    header.capacity = capacity;
+
+    objects.resize(numObjects);
+    for (auto& object : objects) {
+        uint8_t type;
+        bool isRead = read(in, type) && read(in, object.pose.extent) && read(in, object.elongation) && read(in, object.pose.center);
+        for (int j = 0; j < 3; j++)
+            isRead = isRead && read(in, object.pose.axes[j]);
+        if (!isRead || type >= NUM_SOLID_BODY_TYPES) {
+            std::cerr << "the objects of the trace are broken" << std::endl;
+            return false;
+        }
+        object.type = SolidBodyType(type);
+    }
+    return true;
+}
+
+bool TraceReader::nextFrame(std::vector<TraceMove>& moves) {
+    moves.clear();
+    uint32_t numMoves;
+    if (!read(in, numMoves))
+        return false;
+    moves.resize(numMoves);
+    for (auto& move : moves) {
+        if (!read(in, move.index) || !read(in, move.displacement) || move.index >= objects.size()) {
+            std::cerr << "the frame of the trace is broken" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "octree.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// a recorded workload of an octree: the objects in it when the recording starts, then the moves proposed every frame
+// replaying the moves with Octree::move drives an octree through the same sweeps and updates
+//
+// binary, in the byte order of the machine:
+// header: "OCTR", version (u32), max coordinate (f32), fat margin (f32), capacity (i32), number of objects (u32)
+// object: type (u8), extent (f32), elongation (f32), center (3 f32), axes (9 f32, by column)
+// frame: number of moves (u32), then per move: index of the object (u32), displacement (3 f32)
+struct TraceHeader {
+    float maxCoordinate;
+    float fatMargin;
+    int capacity;
+};
+
+struct TraceObject {
+    SolidBodyType type;
+    float elongation;
+    Pose pose; // committed
+};
+
+struct TraceMove {
+    uint32_t index; // in the objects of the trace
+    glm::vec3 displacement;
+};
+
+class TraceWriter {
+public:
+    // writes the octree and the committed poses of the objects, numbered in the order given
+    bool open(const std::string& path, const Octree& octree, const std::vector<const Body*>& objects);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+
+    // the object has to be one of those given to open
+    void addMove(const Body* object, const glm::vec3& displacement);
+    // writes the moves added since the last frame, even if there are none
+    void endFrame();
+private:
+    std::ofstream out;
+    std::unordered_map<const Body*, uint32_t> index;
+    std::vector<TraceMove> moves;
+};
+
+class TraceReader {
+public:
+    // reads the header and the objects
+    bool open(const std::string& path);
+
+    TraceHeader header;
+    std::vector<TraceObject> objects;
+
+    // false at the end of the trace (or if it is broken)
+    bool nextFrame(std::vector<TraceMove>& moves);
+private:
+    std::ifstream in;
+};